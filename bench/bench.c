@@ -0,0 +1,384 @@
+/*
+  Benchmark of the processing done after the samples are captured, run on synthetic GPIO data.
+  Does not need any hardware, so it can run on the Pi as well as on x86 CI.
+  Results are printed to stdout as JSON, progress and errors go to stderr.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "argtable3/argtable3.h"
+
+#include "capture.h"
+#include "convert.h"
+#include "export.h"
+#include "arena.h"
+#include "pipeline.h"
+#include "trigger.h"
+#include "decode.h"
+#include "edges.h"
+#include "sigstats.h"
+
+// helper macro to convert value to string
+#define STR_HELPER(s) #s
+#define STR(s) STR_HELPER(s)
+
+// gitrev identification from CMake
+#ifndef GITREV
+#define GITREV "unknown"
+#endif
+
+#define BENCH_SAMPLES_DEFAULT     (1000000)
+#define BENCH_CHANNELS_DEFAULT    (8)
+#define BENCH_DENSITY_DEFAULT     (0.01)
+#define BENCH_REPEAT_DEFAULT      (5)
+#define BENCH_SAMPLE_RATE         (5000000.0)
+#define BENCH_CHANNELS_MAX        (32)
+
+// extra arena space for small allocations of the exporters
+#define BENCH_ARENA_SLACK         (64UL*1024UL)
+
+static struct bench_t {
+  size_t num_samples;
+  unsigned int num_pins;
+  double density;
+  int repeat;
+  const char* dir;
+
+  int pins[BENCH_CHANNELS_MAX];
+  char label_buffs[BENCH_CHANNELS_MAX][8];
+  const char* labels[BENCH_CHANNELS_MAX];
+  struct capture_t cap;
+
+  // raw GPIO level words (also as GPLEV0/GPLEV1 pairs), gathered channel words and sigrok-packed samples
+  uint32_t* raw;
+  uint32_t* raw_wide;
+  uint32_t* words;
+  uint8_t* packed;
+
+  // edge index of all channels, shared by the decoders
+  struct edges_t edges;
+} bench = {
+  .num_samples = BENCH_SAMPLES_DEFAULT,
+  .num_pins = BENCH_CHANNELS_DEFAULT,
+  .density = BENCH_DENSITY_DEFAULT,
+  .repeat = BENCH_REPEAT_DEFAULT,
+  .dir = "/tmp",
+};
+
+static double bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((double)ts.tv_sec + (double)ts.tv_nsec/1.0e9);
+}
+
+// xorshift, reproducible data for every run
+static uint64_t bench_rand(uint64_t* state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return(x);
+}
+
+static void bench_setup() {
+  // spread the channels over the bank like a real pinout would
+  for(unsigned int i = 0; i < bench.num_pins; i++) {
+    bench.pins[i] = (i * 7) % 32;
+    sprintf(bench.label_buffs[i], "BCM%d", bench.pins[i]);
+    bench.labels[i] = bench.label_buffs[i];
+  }
+
+  memset(&bench.cap, 0, sizeof(bench.cap));
+  bench.cap.num_pins = bench.num_pins;
+  bench.cap.pins = bench.pins;
+  bench.cap.labels = bench.labels;
+  bench.cap.num_samples = bench.num_samples;
+  bench.cap.samp_rate = BENCH_SAMPLE_RATE;
+}
+
+static void bench_generate() {
+  // every channel toggles with the given probability per sample
+  // the top 53 bits give a uniform double in [0, 1), so density 1 toggles in every sample
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  uint32_t level = 0;
+  for(size_t i = 0; i < bench.num_samples; i++) {
+    for(unsigned int j = 1; j < bench.num_pins; j++) {
+      if((double)(bench_rand(&state) >> 11) * 0x1.0p-53 < bench.density) {
+        level ^= (1UL << bench.pins[j]);
+      }
+    }
+    bench.raw[i] = level;
+  }
+
+  // the first channel is the trigger, it only rises in the very last sample so that the scan covers everything
+  bench.raw[bench.num_samples - 1] |= (1UL << bench.pins[0]);
+
+  // same levels with an idle second bank
+  for(size_t i = 0; i < bench.num_samples; i++) {
+    bench.raw_wide[2*i] = bench.raw[i];
+    bench.raw_wide[2*i + 1] = 0;
+  }
+}
+
+static int bench_gather() {
+  convert_samples(bench.raw, bench.words, bench.num_samples, bench.pins, bench.num_pins);
+  return(EXIT_SUCCESS);
+}
+
+static int bench_gather_wide() {
+  convert_samples_wide(bench.raw_wide, bench.words, bench.num_samples, bench.pins, bench.num_pins);
+  return(EXIT_SUCCESS);
+}
+
+static int bench_pack() {
+  convert_pack(bench.words, bench.packed, bench.num_samples, (bench.num_pins + 7) / 8);
+  return(EXIT_SUCCESS);
+}
+
+static int bench_metadata() {
+  char buff[4096];
+  return((export_sr_metadata(buff, sizeof(buff), &bench.cap) < 0) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static int bench_trigger() {
+  size_t idx = trigger_scan(bench.words, bench.num_samples, 0, TRIG_TYPE_RISING);
+  return((idx == bench.num_samples - 1) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static int bench_export(const char* name, bool summary) {
+  const struct exporter_t* exporter = export_find(name);
+  struct export_opts_t opts = { .async = false, .direct = false, .summary = summary };
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/pinalyzer_bench.%s", bench.dir, exporter->ext);
+
+  // write the output in segments, the same way as the pipeline does
+  size_t mark = arena_mark();
+  void* ctx = exporter->open(filename, &bench.cap, &opts);
+  if(!ctx) {
+    arena_release(mark);
+    return(EXIT_FAILURE);
+  }
+
+  int ret = EXIT_SUCCESS;
+  for(size_t offset = 0; (offset < bench.num_samples) && (ret == EXIT_SUCCESS); offset += PIPELINE_SEGMENT_SAMPLES) {
+    struct segment_t seg = { .samples = &bench.words[offset], .offset = offset, .len = bench.num_samples - offset };
+    if(seg.len > PIPELINE_SEGMENT_SAMPLES) { seg.len = PIPELINE_SEGMENT_SAMPLES; }
+    ret = exporter->write(ctx, &seg);
+  }
+
+  if(exporter->close(ctx) != EXIT_SUCCESS) {
+    ret = EXIT_FAILURE;
+  }
+  arena_release(mark);
+  unlink(filename);
+  return(ret);
+}
+
+static int bench_export_sr() { return(bench_export("sr", false)); }
+static int bench_export_vcd() { return(bench_export("vcd", false)); }
+static int bench_export_raw() { return(bench_export("raw", false)); }
+static int bench_export_raw_summary() { return(bench_export("raw", true)); }
+
+static int bench_edges() {
+  edges_free(&bench.edges);
+  return(edges_build(&bench.edges, bench.words, bench.num_samples, (bench.num_pins < 32) ? ((1UL << bench.num_pins) - 1) : UINT32_MAX));
+}
+
+static int bench_sigstats() {
+  struct sigstats_t stats[BENCH_CHANNELS_MAX];
+  sigstats_compute(&bench.edges, &bench.cap, stats);
+  return(EXIT_SUCCESS);
+}
+
+// run decoder with spec where %d are replaced by the pins of the first channels
+static int bench_decode(const char* fmt) {
+  if(bench.num_pins < 4) {
+    return(EXIT_SUCCESS);
+  }
+
+  char spec[128];
+  snprintf(spec, sizeof(spec), fmt, bench.pins[0], bench.pins[1], bench.pins[2], bench.pins[3]);
+  const char* opts;
+  const struct decoder_t* decoder = decode_find(spec, &opts);
+  void* ctx = decoder ? decoder->init(opts, &bench.cap) : NULL;
+  if(!ctx) {
+    return(EXIT_FAILURE);
+  }
+
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/pinalyzer_bench.dec", bench.dir);
+  struct decode_out_t out = { .fp = fopen(filename, "wb"), .fmt = DECODE_FMT_BIN };
+  int ret = EXIT_FAILURE;
+  if(out.fp) {
+    ret = decoder->run(ctx, bench.words, bench.num_samples, &bench.edges, &out);
+    fclose(out.fp);
+    unlink(filename);
+  }
+  decoder->free(ctx);
+  return(ret);
+}
+
+// random data on the first channel is idle low, so SPI sees one long transaction
+static int bench_decode_spi() { return(bench_decode("spi:cs=%d,clk=%d,mosi=%d,miso=%d")); }
+static int bench_decode_i2c() { return(bench_decode("i2c:scl=%2$d,sda=%3$d")); }
+static int bench_decode_uart() { return(bench_decode("uart:rx=%2$d,rx=%3$d,rx=%4$d")); }
+
+// the cases depend on output of the previous ones, gather must go before the rest and edges before the statistics and decoders
+static const struct bench_case_t {
+  const char* name;
+  int (*func)();
+} cases[] = {
+  { .name = "gather_wide", .func = bench_gather_wide },
+  { .name = "gather", .func = bench_gather },
+  { .name = "pack", .func = bench_pack },
+  { .name = "metadata", .func = bench_metadata },
+  { .name = "trigger", .func = bench_trigger },
+  { .name = "export_sr", .func = bench_export_sr },
+  { .name = "export_vcd", .func = bench_export_vcd },
+  { .name = "export_raw", .func = bench_export_raw },
+  { .name = "export_raw_summary", .func = bench_export_raw_summary },
+  { .name = "edges", .func = bench_edges },
+  { .name = "sigstats", .func = bench_sigstats },
+  { .name = "decode_spi", .func = bench_decode_spi },
+  { .name = "decode_i2c", .func = bench_decode_i2c },
+  { .name = "decode_uart", .func = bench_decode_uart },
+};
+
+static int run() {
+  bench_setup();
+
+  // the sample buffers stay for the whole run, each exporter releases its memory after closing
+  struct export_opts_t opts = { .async = false, .direct = false, .summary = true };
+  size_t export_bytes = 0;
+  const char* formats[] = { "sr", "vcd", "raw" };
+  for(size_t i = 0; i < sizeof(formats)/sizeof(formats[0]); i++) {
+    size_t size = export_find(formats[i])->mem_size(&bench.cap, &opts);
+    if(size > export_bytes) { export_bytes = size; }
+  }
+  size_t buff_bytes = 5 * bench.num_samples * sizeof(uint32_t);
+  if(arena_init(buff_bytes + export_bytes + BENCH_ARENA_SLACK) != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+
+  bench.raw = arena_alloc(bench.num_samples * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+  bench.raw_wide = arena_alloc(2 * bench.num_samples * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+  bench.words = arena_alloc(bench.num_samples * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+  bench.packed = arena_alloc(bench.num_samples * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+  if(!bench.raw || !bench.raw_wide || !bench.words || !bench.packed) {
+    fprintf(stderr, "Failed to allocate sample buffers\n");
+    return(EXIT_FAILURE);
+  }
+  bench_generate();
+
+  fprintf(stdout, "{\n");
+  fprintf(stdout, "  \"gitrev\": \"%s\",\n", GITREV);
+  fprintf(stdout, "  \"samples\": %lu,\n", bench.num_samples);
+  fprintf(stdout, "  \"channels\": %u,\n", bench.num_pins);
+  fprintf(stdout, "  \"density\": %g,\n", bench.density);
+  fprintf(stdout, "  \"repeat\": %d,\n", bench.repeat);
+  fprintf(stdout, "  \"results\": [\n");
+
+  int ret = EXIT_SUCCESS;
+  const size_t num_cases = sizeof(cases)/sizeof(cases[0]);
+  for(size_t i = 0; i < num_cases; i++) {
+    double best = 0, total = 0;
+    bool ok = true;
+    for(int r = 0; (r < bench.repeat) && ok; r++) {
+      double start = bench_now();
+      ok = (cases[i].func() == EXIT_SUCCESS);
+      double elapsed = bench_now() - start;
+      total += elapsed;
+      if((r == 0) || (elapsed < best)) { best = elapsed; }
+    }
+
+    // the time of a failed case means nothing, so it is reported without any rates
+    if(!ok) {
+      fprintf(stderr, "Benchmark %s failed\n", cases[i].name);
+      fprintf(stdout, "    { \"name\": \"%s\", \"ok\": false }%s\n", cases[i].name, (i < num_cases - 1) ? "," : "");
+      ret = EXIT_FAILURE;
+      continue;
+    }
+
+    fprintf(stderr, "%-18s %10.3f ms\n", cases[i].name, best*1000.0);
+    fprintf(stdout, "    { \"name\": \"%s\", \"ok\": true, \"seconds\": %.9f, \"seconds_avg\": %.9f, \"samples_per_sec\": %.1f, \"ns_per_sample\": %.4f }%s\n",
+      cases[i].name, best, total / bench.repeat, (double)bench.num_samples / best, best * 1.0e9 / (double)bench.num_samples,
+      (i < num_cases - 1) ? "," : "");
+  }
+
+  fprintf(stdout, "  ]\n}\n");
+  edges_free(&bench.edges);
+  return(ret);
+}
+
+int main(int argc, char** argv) {
+  struct {
+    struct arg_int* samples;
+    struct arg_int* channels;
+    struct arg_dbl* density;
+    struct arg_int* repeat;
+    struct arg_str* dir;
+    struct arg_lit* help;
+    struct arg_end* end;
+  } args;
+
+  void *argtable[] = {
+    args.samples = arg_int0("n", "samples", NULL, "Number of samples, defaults to " STR(BENCH_SAMPLES_DEFAULT)),
+    args.channels = arg_int0("c", "channels", NULL, "Number of captured channels, 1 - 32, defaults to " STR(BENCH_CHANNELS_DEFAULT)),
+    args.density = arg_dbl0("d", "density", NULL, "Probability of a channel toggling in each sample, defaults to " STR(BENCH_DENSITY_DEFAULT)),
+    args.repeat = arg_int0("r", "repeat", NULL, "Number of runs of each benchmark, the fastest one is reported, defaults to " STR(BENCH_REPEAT_DEFAULT)),
+    args.dir = arg_str0("o", "dir", NULL, "Directory for the temporary output files, defaults to /tmp"),
+    args.help = arg_lit0(NULL, "help", "Display this help and exit"),
+    args.end = arg_end(3),
+  };
+
+  int exitcode = EXIT_SUCCESS;
+  if(arg_nullcheck(argtable) != 0) {
+    fprintf(stderr, "%s: insufficient memory\n", argv[0]);
+    exitcode = EXIT_FAILURE;
+    goto exit;
+  }
+
+  int nerrors = arg_parse(argc, argv, argtable);
+  if(args.help->count > 0) {
+    fprintf(stdout, "pinalyzer processing benchmark, gitrev " GITREV "\n");
+    fprintf(stdout, "Usage: %s", argv[0]);
+    arg_print_syntax(stdout, argtable, "\n");
+    arg_print_glossary(stdout, argtable,"  %-25s %s\n");
+    exitcode = EXIT_SUCCESS;
+    goto exit;
+  }
+
+  if(nerrors > 0) {
+    arg_print_errors(stdout, args.end, argv[0]);
+    fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+    exitcode = EXIT_FAILURE;
+    goto exit;
+  }
+
+  if(args.samples->count) { bench.num_samples = args.samples->ival[0]; }
+  if(args.channels->count) { bench.num_pins = args.channels->ival[0]; }
+  if(args.density->count) { bench.density = args.density->dval[0]; }
+  if(args.repeat->count) { bench.repeat = args.repeat->ival[0]; }
+  if(args.dir->count) { bench.dir = args.dir->sval[0]; }
+
+  if((bench.num_samples < 2) || (bench.num_pins < 1) || (bench.num_pins > BENCH_CHANNELS_MAX) ||
+     (bench.density < 0) || (bench.density > 1) || (bench.repeat < 1)) {
+    fprintf(stderr, "Invalid benchmark parameters\n");
+    exitcode = EXIT_FAILURE;
+    goto exit;
+  }
+
+  exitcode = run();
+
+exit:
+  arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+
+  return(exitcode);
+}
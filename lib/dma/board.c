@@ -0,0 +1,115 @@
+/*
+  Runtime board detection, so that a single binary can run on all supported models.
+  Peripheral base is read from /proc/device-tree/soc/ranges (same as bcm_host_get_peripheral_address),
+  the SoC family is derived from it, and the model string is only used for reporting.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "board.h"
+
+#define BOARD_DT_ROOT_DEFAULT   "/proc/device-tree"
+
+// parameters of each SoC family, identified by the peripheral base address
+static const struct board_family_t {
+  uint32_t periph_base;
+  const char* soc;
+  uint32_t bus_mask;
+  uint32_t bus_offset;
+  double osc_freq;
+  double plld_freq;
+  unsigned int rate_default;
+} families[] = {
+  // Raspberry Pi 4, 400, CM4
+  { .periph_base = 0xFE000000, .soc = "BCM2711", .bus_mask = 0xFFFFFFFF, .bus_offset = 0x80000000,
+    .osc_freq = 54000000.0, .plld_freq = 750000000.0, .rate_default = 5000000 },
+
+  // Raspberry Pi 2, 3, Zero 2, CM3
+  { .periph_base = 0x3F000000, .soc = "BCM2836/7", .bus_mask = ~0xC0000000, .bus_offset = 0,
+    .osc_freq = 19200000.0, .plld_freq = 500000000.0, .rate_default = 5000000 },
+
+  // Raspberry Pi 1, Zero, CM1
+  { .periph_base = 0x20000000, .soc = "BCM2835", .bus_mask = ~0xC0000000, .bus_offset = 0,
+    .osc_freq = 19200000.0, .plld_freq = 500000000.0, .rate_default = 5000000 },
+};
+
+static struct board_t board;
+
+static void board_set_family(const struct board_family_t* fam) {
+  board.soc = fam->soc;
+  board.periph_base = fam->periph_base;
+  board.bus_mask = fam->bus_mask;
+  board.bus_offset = fam->bus_offset;
+  board.osc_freq = fam->osc_freq;
+  board.plld_freq = fam->plld_freq;
+  board.rate_default = fam->rate_default;
+}
+
+// device tree cells are big endian
+static uint32_t board_read_cell(const uint8_t* buff) {
+  return(((uint32_t)buff[0] << 24) | ((uint32_t)buff[1] << 16) | ((uint32_t)buff[2] << 8) | (uint32_t)buff[3]);
+}
+
+static int board_read_file(const char* dt_root, const char* name, uint8_t* buff, size_t len) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dt_root, name);
+  FILE* fp = fopen(path, "rb");
+  if(!fp) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return(-1);
+  }
+
+  size_t read = fread(buff, 1, len, fp);
+  fclose(fp);
+  return((int)read);
+}
+
+int board_init(const char* dt_root) {
+  if(!dt_root) {
+    dt_root = BOARD_DT_ROOT_DEFAULT;
+  }
+
+  // model is a null-terminated string
+  memset(&board, 0, sizeof(board));
+  int len = board_read_file(dt_root, "model", (uint8_t*)board.model, sizeof(board.model) - 1);
+  if(len < 0) {
+    return(-1);
+  }
+  board.model[len] = '\0';
+
+  // the first range maps the peripheral bus address to the physical one
+  // older SoCs use single-cell parent address, BCM2711 uses two cells with the upper one zero
+  uint8_t ranges[12];
+  len = board_read_file(dt_root, "soc/ranges", ranges, sizeof(ranges));
+  if(len < 8) {
+    fprintf(stderr, "Invalid device tree ranges\n");
+    return(-1);
+  }
+  uint32_t base = board_read_cell(&ranges[4]);
+  if((base == 0) && (len >= 12)) {
+    base = board_read_cell(&ranges[8]);
+  }
+
+  for(size_t i = 0; i < sizeof(families)/sizeof(families[0]); i++) {
+    if(families[i].periph_base == base) {
+      board_set_family(&families[i]);
+      return(0);
+    }
+  }
+
+  fprintf(stderr, "Unsupported board %s, peripherals at 0x%08X\n", board.model, base);
+  return(-1);
+}
+
+void board_use_default() {
+  memset(&board, 0, sizeof(board));
+  snprintf(board.model, sizeof(board.model), "default");
+  board_set_family(&families[0]);
+}
+
+const struct board_t* board_get() {
+  return(&board);
+}
@@ -0,0 +1,38 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+
+// everything that differs between the supported Raspberry Pi models
+struct board_t {
+  // model string from device tree, and the SoC it uses
+  char model[128];
+  const char* soc;
+
+  // physical address of the peripherals, as seen by the ARM core
+  uint32_t periph_base;
+
+  // conversion of VideoCore bus addresses of DMA memory to physical: (bus & mask) + offset
+  uint32_t bus_mask;
+  uint32_t bus_offset;
+
+  // frequencies of the clock sources usable for the PWM clock, in Hz
+  double osc_freq;
+  double plld_freq;
+
+  // default sample rate, can be tuned for each board according to --probe-rate results
+  unsigned int rate_default;
+};
+
+// detect the board from device tree at dt_root, NULL means /proc/device-tree
+// a directory with copies of the model and soc/ranges files can be used for testing
+// returns 0 on success, -1 if the board could not be detected or is not supported
+int board_init(const char* dt_root);
+
+// use the defaults (Raspberry Pi 4) when there is no device tree, e.g. in simulation
+void board_use_default();
+
+// the detected board
+const struct board_t* board_get();
+
+#endif
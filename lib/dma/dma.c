@@ -3,43 +3,20 @@
 */
 
 #include <stdio.h>
-#include <assert.h>
 #include <unistd.h>
 #include <time.h>
-#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <sys/mman.h>
+#include <math.h>
 #include <signal.h>
+#include <stddef.h>
 
-#include "mailbox.h"
 #include "dma.h"
+#include "hal.h"
 #include "registers.h"
 
-typedef struct DMACtrlReg {
-  uint32_t cs;      // DMA Channel Control and Status register
-  uint32_t cb_addr; // DMA Channel Control Block Address
-} DMACtrlReg;
-
-typedef struct DMAControlBlock {
-  uint32_t tx_info;    // Transfer information
-  uint32_t src;        // Source (bus) address
-  uint32_t dest;       // Destination (bus) address
-  uint32_t tx_len;     // Transfer length (in bytes)
-  uint32_t stride;     // 2D stride
-  uint32_t next_cb;    // Next DMAControlBlock (bus) address
-  uint32_t padding[2]; // 2-word padding
-} DMAControlBlock;
-
-typedef struct DMAMemHandle {
-  void *virtual_addr; // Virutal base address of the page
-  uint32_t bus_addr;  // Bus adress of the page, this is not a pointer because it does not point to valid virtual address
-  uint32_t mb_handle; // Used by mailbox property interface
-  uint32_t size;
-} DMAMemHandle;
-
 typedef struct CLKCtrlReg {
   // See https://elinux.org/BCM2835_registers#CM
   uint32_t ctrl;
@@ -59,124 +36,250 @@ typedef struct PWMCtrlReg {
   uint32_t data2;    // 0x24, Channel 2 data
 } PWMCtrlReg;
 
-static volatile DMACtrlReg *dma_reg;
+// limits of the PWM clock solver
+#define DMA_PWM_CLK_MAX       (100000000.0)
+#define DMA_PWM_RANGE_MIN     (2)
+#define DMA_CLOCK_SEARCH_MAX  (65536UL)
+
+// throttled captures longer than this run in a ring of control blocks that is reused until the capture is done
+#define DMA_RING_SAMPLES      (64UL*1024UL)
+
+// reading the ring position is retried while the DMA is at the lap block, which is a single word transfer
+#define DMA_PROGRESS_RETRIES  (1000)
+
+// integer dividers are preferred when they get this close, fractional divider adds jitter
+#define DMA_CLOCK_TOLERANCE   (1.0e-5)
+
 static volatile PWMCtrlReg *pwm_reg;
 static volatile CLKCtrlReg *clk_reg;
 
 static struct dma_conf_t {
   size_t num_samples;
   size_t num_cbs;
+  unsigned int sample_words;
+
+  // number of samples in the DMA buffer, less than num_samples if the chain is a ring
+  size_t buff_len;
+  bool ring;
+  size_t cbs_per_sample;
 
-  int mailbox_fd;
+  // the lap block at the end of the ring advances its own source address through a table of lap numbers
+  size_t num_laps;
+  size_t lap_cb;
+
+  // last progress seen while the channel was running
+  size_t progress;
+
+  struct dma_opts_t opts;
+  size_t num_timestamps;
+
+  const HALBackend* hal;
+  bool started;
   DMAMemHandle* dma_cbs;
   DMAMemHandle* dma_samples;
+  DMAMemHandle* dma_timestamps;
+  DMAMemHandle* dma_laps;
+  DMAMemHandle cbs_mem;
+  DMAMemHandle samples_mem;
+  DMAMemHandle timestamps_mem;
+  DMAMemHandle laps_mem;
+  struct dma_timing_t timing;
+  struct dma_clock_t clock;
+  bool throttled;
 } dma_conf = {
   .num_samples = 0,
   .num_cbs = 0,
-
-  .mailbox_fd = -1,
+  .sample_words = 1,
+  .buff_len = 0,
+  .ring = false,
+  .cbs_per_sample = 1,
+  .num_laps = 0,
+  .lap_cb = 0,
+  .progress = 0,
+  .opts = DMA_OPTS_DEFAULT,
+  .num_timestamps = 0,
+
+  .hal = NULL,
+  .started = false,
   .dma_cbs = NULL,
   .dma_samples = NULL,
+  .dma_timestamps = NULL,
+  .dma_laps = NULL,
 };
 
-static DMAMemHandle *dma_malloc(unsigned int size) {
-  if(dma_conf.mailbox_fd < 0) {
-    dma_conf.mailbox_fd = mbox_open();
-    assert(dma_conf.mailbox_fd >= 0);
-  }
+static double dma_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((double)ts.tv_sec + (double)ts.tv_nsec/1.0e9);
+}
 
+static DMAMemHandle *dma_malloc(DMAMemHandle *mem, unsigned int size) {
   // Make `size` a multiple of PAGE_SIZE
   size = ((size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
 
-  DMAMemHandle *mem = (DMAMemHandle *)malloc(sizeof(DMAMemHandle));
-  // Documentation: https://github.com/raspberrypi/firmware/wiki/Mailbox-property-interface
-  mem->mb_handle = mem_alloc(dma_conf.mailbox_fd, size, PAGE_SIZE, MEM_FLAG_L1_NONALLOCATING);
-  mem->bus_addr = mem_lock(dma_conf.mailbox_fd, mem->mb_handle);
-  mem->virtual_addr = mapmem(BUS_TO_PHYS(mem->bus_addr), size);
-  mem->size = size;
-
-  assert(mem->bus_addr != 0);
+  if(dma_conf.hal->mem_alloc(mem, size) != 0) {
+    fprintf(stderr, "Failed to allocate %u bytes of DMA memory\n", size);
+    exit(-1);
+  }
 
-  fprintf(stderr, "MBox alloc: %d bytes, bus: %08X, virt: %08X\n", mem->size, mem->bus_addr, (int)mem->virtual_addr);
+  fprintf(stderr, "DMA alloc: %d bytes, bus: %08X, virt: %p\n", mem->size, mem->bus_addr, mem->virtual_addr);
 
   return (mem);
 }
 
 static void dma_free(DMAMemHandle *mem) {
-  if(mem->virtual_addr == NULL) {
+  if((mem == NULL) || (mem->virtual_addr == NULL)) {
     return;
   }
 
-  unmapmem(mem->virtual_addr, PAGE_SIZE);
-  mem_unlock(dma_conf.mailbox_fd, mem->mb_handle);
-  mem_free(dma_conf.mailbox_fd, mem->mb_handle);
+  dma_conf.hal->mem_free(mem);
   mem->virtual_addr = NULL;
 }
 
-static void *map_peripheral(uint32_t addr, uint32_t size) {
-  int mem_fd;
+static void dma_alloc_buffers() {
+  dma_conf.dma_samples = dma_malloc(&dma_conf.samples_mem, dma_conf.buff_len * dma_conf.sample_words * sizeof(uint32_t));
+  dma_conf.dma_cbs = dma_malloc(&dma_conf.cbs_mem, dma_conf.num_cbs * sizeof(DMAControlBlock));
+  dma_conf.dma_timestamps = NULL;
+  dma_conf.timestamps_mem.size = 0;
+  if(dma_conf.num_timestamps) {
+    dma_conf.dma_timestamps = dma_malloc(&dma_conf.timestamps_mem, dma_conf.num_timestamps * sizeof(uint32_t));
+  }
+  dma_conf.dma_laps = NULL;
+  dma_conf.laps_mem.size = 0;
+  if(dma_conf.ring) {
+    dma_conf.dma_laps = dma_malloc(&dma_conf.laps_mem, (dma_conf.num_laps + 1) * sizeof(uint32_t));
+  }
+}
 
-  // Check mem(4) about /dev/mem
-  if((mem_fd = open("/dev/mem", O_RDWR | O_SYNC)) < 0) {
-    perror("Failed to open /dev/mem: ");
-    exit(-1);
+static inline void* dma_buff_virt_addr(DMAMemHandle* mem, int i, size_t size) { return mem->virtual_addr + i * size; }
+static inline uint32_t dma_buff_bus_addr(DMAMemHandle* mem, int i, size_t size) { return mem->bus_addr + i * size; }
+
+static DMAControlBlock* dma_add_cb(int* cb_idx, uint32_t tx_info, uint32_t src, uint32_t dest, uint32_t len) {
+  DMAControlBlock *cb = (DMAControlBlock*)dma_buff_virt_addr(dma_conf.dma_cbs, *cb_idx, sizeof(DMAControlBlock));
+  cb->tx_info = tx_info;
+  cb->src = src;
+  cb->dest = dest;
+  cb->tx_len = len;
+  (*cb_idx)++;
+  cb->next_cb = dma_buff_bus_addr(dma_conf.dma_cbs, *cb_idx, sizeof(DMAControlBlock));
+  return(cb);
+}
+
+static void dma_init_cbs(bool delay) {
+  int cb_idx = 0;
+  DMAControlBlock *cb = NULL;
+  uint32_t wait_resp = dma_conf.opts.wait_resp ? DMA_WAIT_RESP : 0;
+  uint32_t syst_clo = PERI_BUS_BASE + SYST_BASE + SYST_CLO;
+  for(size_t i = 0; i < dma_conf.buff_len; i++) {
+    // insert timestamp block at the start of each interval
+    if(dma_conf.num_timestamps && ((i % DMA_TIMESTAMP_INTERVAL) == 0)) {
+      dma_add_cb(&cb_idx, DMA_NO_WIDE_BURSTS | wait_resp, syst_clo,
+        dma_buff_bus_addr(dma_conf.dma_timestamps, i / DMA_TIMESTAMP_INTERVAL, sizeof(uint32_t)), 4);
+    }
+
+    // insert sample control block, for both banks GPLEV0 and GPLEV1 are read in a single transfer
+    // channel 9 is a lite channel without 2D mode, but incrementing addresses is enough for two adjacent registers
+    uint32_t len = dma_conf.sample_words * sizeof(uint32_t);
+    uint32_t inc = (dma_conf.sample_words > 1) ? (DMA_SRC_INC | DMA_DEST_INC) : 0;
+    cb = dma_add_cb(&cb_idx, DMA_NO_WIDE_BURSTS | wait_resp | inc, PERI_BUS_BASE + GPIO_BASE + GPLEV0,
+      dma_buff_bus_addr(dma_conf.dma_samples, i, len), len);
+
+    // insert delay block if needed
+    if(delay) {
+      cb = dma_add_cb(&cb_idx, DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP | DMA_DEST_DREQ | DMA_PERIPHERAL_MAPPING(5),
+        dma_buff_bus_addr(dma_conf.dma_cbs, 0, sizeof(DMAControlBlock)), PERI_BUS_BASE + PWM_BASE + PWM_FIFO, 4);
+    }
   }
 
-  uint32_t *result = (uint32_t *)mmap(
-      NULL,
-      size,
-      PROT_READ | PROT_WRITE,
-      MAP_SHARED,
-      mem_fd,
-      PERI_PHYS_BASE + addr);
+  // the last timestamp marks the end of the capture
+  if(dma_conf.num_timestamps) {
+    cb = dma_add_cb(&cb_idx, DMA_NO_WIDE_BURSTS | wait_resp, syst_clo,
+      dma_buff_bus_addr(dma_conf.dma_timestamps, dma_conf.num_timestamps - 1, sizeof(uint32_t)), 4);
+  }
 
-  close(mem_fd);
+  // the lap block copies the table entry its source points at into its own source, so it moves one entry per lap
+  // each entry holds the address of the next one, the last one points to itself so that the count saturates
+  if(dma_conf.ring) {
+    uint32_t* laps = (uint32_t*)dma_conf.dma_laps->virtual_addr;
+    for(size_t i = 0; i <= dma_conf.num_laps; i++) {
+      laps[i] = dma_buff_bus_addr(dma_conf.dma_laps, (i < dma_conf.num_laps) ? i + 1 : i, sizeof(uint32_t));
+    }
+    dma_conf.lap_cb = cb_idx;
+    uint32_t lap_src = dma_buff_bus_addr(dma_conf.dma_cbs, cb_idx, sizeof(DMAControlBlock)) + offsetof(DMAControlBlock, src);
+    cb = dma_add_cb(&cb_idx, DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP, dma_buff_bus_addr(dma_conf.dma_laps, 0, sizeof(uint32_t)), lap_src, 4);
+  }
 
-  if (result == MAP_FAILED) {
-    perror("mmap error: ");
-    exit(-1);
+  // terminate the chain after the last block, or loop back to the start
+  if(cb) {
+    cb->next_cb = dma_conf.ring ? dma_buff_bus_addr(dma_conf.dma_cbs, 0, sizeof(DMAControlBlock)) : 0;
   }
 
-  return(result);
+  fprintf(stderr, "DMA init: %lu control blocks, %lu samples%s\n", dma_conf.num_cbs, dma_conf.buff_len, dma_conf.ring ? " in a ring" : "");
 }
 
-static void dma_alloc_buffers() {
-  dma_conf.dma_samples = dma_malloc(dma_conf.num_samples * sizeof(uint32_t));
-  dma_conf.dma_cbs = dma_malloc(dma_conf.num_cbs * sizeof(DMAControlBlock));
+static void dma_clock_eval(struct dma_clock_t* clk, double* best_err, unsigned int src, double src_freq, unsigned int divi, unsigned int divf, double range) {
+  if((range < DMA_PWM_RANGE_MIN) || (range > (double)UINT32_MAX)) {
+    return;
+  }
+
+  double rate = src_freq / (((double)divi + (double)divf/4096.0) * range);
+  double err = fabs(rate - clk->rate_requested) / clk->rate_requested;
+  if(err < *best_err) {
+    *best_err = err;
+    clk->src = src;
+    clk->src_freq = src_freq;
+    clk->divi = divi;
+    clk->divf = divf;
+    clk->mash = divf ? 1 : 0;
+    clk->range = (unsigned int)range;
+    clk->rate = rate;
+  }
 }
 
-static inline void* dma_buff_virt_addr(DMAMemHandle* mem, int i, size_t size) { return mem->virtual_addr + i * size; }
-static inline uint32_t dma_buff_bus_addr(DMAMemHandle* mem, int i, size_t size) { return mem->bus_addr + i * size; }
+int dma_solve_clock(double rate, struct dma_clock_t* clk) {
+  const struct { unsigned int src; double freq; } sources[] = {
+    { CLK_CTL_SRC_OSC, CLK_OSC_FREQ },
+    { CLK_CTL_SRC_PLLD, CLK_PLLD_FREQ },
+  };
 
-static void dma_init_cbs(bool delay) {
-  int cb_idx = 0;
-  DMAControlBlock *cb;
-  for(size_t i = 0; i < dma_conf.num_samples; i++) {
-    // insert sample control block
-    cb = (DMAControlBlock*)dma_buff_virt_addr(dma_conf.dma_cbs, cb_idx, sizeof(DMAControlBlock));
-    cb->tx_info = DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP;
-    cb->src = PERI_BUS_BASE + GPIO_BASE + GPLEV0;
-    cb->dest = dma_buff_bus_addr(dma_conf.dma_samples, i, sizeof(uint32_t));
-    cb->tx_len = 4;
-    cb_idx++;
-    cb->next_cb = dma_buff_bus_addr(dma_conf.dma_cbs, cb_idx, sizeof(DMAControlBlock));
+  memset(clk, 0, sizeof(struct dma_clock_t));
+  clk->rate_requested = rate;
+  if(rate <= 0) {
+    return(-1);
+  }
 
-    // insert delay block if needed
-    if(delay) {
-      cb = (DMAControlBlock*)dma_buff_virt_addr(dma_conf.dma_cbs, cb_idx, sizeof(DMAControlBlock));
-      cb->tx_info = DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP | DMA_DEST_DREQ | DMA_PERIPHERAL_MAPPING(5);
-      cb->src = dma_buff_bus_addr(dma_conf.dma_cbs, 0, sizeof(DMAControlBlock));
-      cb->dest = PERI_BUS_BASE + PWM_BASE + PWM_FIFO;
-      cb->tx_len = 4;
-      cb_idx++;
-      cb->next_cb = dma_buff_bus_addr(dma_conf.dma_cbs, cb_idx, sizeof(DMAControlBlock));
+  // integer dividers first, the oscillator goes first since it is the more stable source
+  double best_err = INFINITY;
+  for(size_t i = 0; i < sizeof(sources)/sizeof(sources[0]); i++) {
+    unsigned int divi_min = (unsigned int)ceil(sources[i].freq / DMA_PWM_CLK_MAX);
+    if(divi_min < 2) { divi_min = 2; }
+    for(unsigned int divi = divi_min; divi <= CLK_DIVI_MAX; divi++) {
+      double range = round(sources[i].freq / (divi * rate));
+      dma_clock_eval(clk, &best_err, sources[i].src, sources[i].freq, divi, 0, range);
     }
   }
 
-  fprintf(stderr, "DMA init: %lu control blocks, %lu samples\n", dma_conf.num_cbs, dma_conf.num_samples);
+  // fractional dividers with MASH filter, smaller ranges mean larger dividers and finer steps
+  for(size_t i = 0; (i < sizeof(sources)/sizeof(sources[0])) && (best_err > DMA_CLOCK_TOLERANCE); i++) {
+    double div_min = fmax(2.0, sources[i].freq / DMA_PWM_CLK_MAX);
+    double range_min = fmax(DMA_PWM_RANGE_MIN, ceil(sources[i].freq / (rate * (CLK_DIVI_MAX + 1))));
+    double range_max = floor(sources[i].freq / (rate * div_min));
+    for(double range = range_min; (range <= range_max) && (range < range_min + DMA_CLOCK_SEARCH_MAX); range++) {
+      double div = sources[i].freq / (rate * range);
+      unsigned int divi = (unsigned int)div;
+      unsigned int divf = (unsigned int)round((div - divi) * 4096.0);
+      if(divf > CLK_DIVF_MAX) { divi++; divf = 0; }
+      if((divi < 2) || (divi > CLK_DIVI_MAX)) {
+        continue;
+      }
+      dma_clock_eval(clk, &best_err, sources[i].src, sources[i].freq, divi, divf, range);
+    }
+  }
+
+  return(isinf(best_err) ? -1 : 0);
 }
 
-static void init_hw_clk(int div) {
+static void init_hw_clk(const struct dma_clock_t* clk) {
   // kill the clock if busy
   if(clk_reg->ctrl & CLK_CTL_BUSY) {
     do {
@@ -184,12 +287,12 @@ static void init_hw_clk(int div) {
     } while(clk_reg->ctrl & CLK_CTL_BUSY);
   }
 
-  // set clock source to PLLD
-  clk_reg->ctrl = BCM_PASSWD | CLK_CTL_SRC(CLK_CTL_SRC_PLLD);
+  // set clock source and MASH filter, needed for fractional divider
+  clk_reg->ctrl = BCM_PASSWD | CLK_CTL_MASH(clk->mash) | CLK_CTL_SRC(clk->src);
   usleep(10);
 
-  // the original clock speed is 750MHZ, divide it
-  clk_reg->div = BCM_PASSWD | CLK_DIV_DIVI(div);
+  // divide the source clock
+  clk_reg->div = BCM_PASSWD | CLK_DIV_DIVI(clk->divi) | CLK_DIV_DIVF(clk->divf);
   usleep(10);
 
   // enable the clock
@@ -219,69 +322,175 @@ static void init_pwm(unsigned int range) {
 }
 
 void dma_start() {
-  // reset the DMA channel
-  dma_reg->cs = DMA_CHANNEL_ABORT;
-  dma_reg->cs = 0;
-  dma_reg->cs = DMA_CHANNEL_RESET;
-  dma_reg->cb_addr = 0;
-
-  dma_reg->cs = DMA_INTERRUPT_STATUS | DMA_END_FLAG;
-
-  // make cb_addr point to the first DMA control block and enable DMA transfer
-  dma_reg->cb_addr = dma_buff_bus_addr(dma_conf.dma_cbs, 0, sizeof(DMAControlBlock));
-  dma_reg->cs = DMA_PRIORITY(8) | DMA_PANIC_PRIORITY(8) | DMA_DISDEBUG;
-  dma_reg->cs |= DMA_WAIT_ON_WRITES | DMA_ACTIVE;
+  uint32_t cs = DMA_PRIORITY(dma_conf.opts.priority & 0xF) | DMA_PANIC_PRIORITY(dma_conf.opts.panic_priority & 0xF) | DMA_DISDEBUG;
+  dma_conf.progress = 0;
+  if(dma_conf.ring) {
+    DMAControlBlock* lap = (DMAControlBlock*)dma_buff_virt_addr(dma_conf.dma_cbs, dma_conf.lap_cb, sizeof(DMAControlBlock));
+    lap->src = dma_buff_bus_addr(dma_conf.dma_laps, 0, sizeof(uint32_t));
+  }
+  dma_conf.hal->dma_start(dma_buff_bus_addr(dma_conf.dma_cbs, 0, sizeof(DMAControlBlock)), cs);
+  dma_conf.started = true;
 }
 
 void dma_end() {
+  if(!dma_conf.hal) {
+    return;
+  }
+
   // shutdown DMA channel
-  dma_reg->cs |= DMA_CHANNEL_ABORT;
-  usleep(100);
-  dma_reg->cs &= ~DMA_ACTIVE;
-  dma_reg->cs |= DMA_CHANNEL_RESET;
-  usleep(100);
+  dma_conf.hal->dma_stop();
 
   // release the memory used by DMA
   dma_free(dma_conf.dma_samples);
   dma_free(dma_conf.dma_cbs);
-
-  free(dma_conf.dma_samples);
-  free(dma_conf.dma_cbs);
+  dma_free(dma_conf.dma_timestamps);
+  dma_free(dma_conf.dma_laps);
+  dma_conf.started = false;
 }
 
-void dma_init(size_t num_samples, unsigned int rate) {
+void dma_init(size_t num_samples, unsigned int rate, const struct dma_opts_t* opts) {
+  const struct dma_opts_t opts_default = DMA_OPTS_DEFAULT;
+  dma_conf.opts = opts ? *opts : opts_default;
   dma_conf.num_samples = num_samples;
-  dma_conf.num_cbs = num_samples;
-
-  // set up access to DMA, PWM and clock registers
-  uint8_t *dma_base_ptr = map_peripheral(DMA_BASE, PAGE_SIZE);
-  dma_reg = (DMACtrlReg *)(dma_base_ptr + DMA_CHANNEL * 0x100);
-  uint8_t *cm_base_ptr = map_peripheral(CM_BASE, CM_LEN);
-  clk_reg = (CLKCtrlReg *)(cm_base_ptr + CM_PWM);
-  pwm_reg = map_peripheral(PWM_BASE, PWM_LEN);
+  dma_conf.buff_len = num_samples;
+  dma_conf.sample_words = dma_conf.opts.bank1 ? 2 : 1;
+  dma_conf.ring = false;
+  dma_conf.num_laps = 0;
+  dma_conf.cbs_per_sample = 1;
+  dma_conf.num_timestamps = 0;
+  dma_conf.started = false;
+
+  // set up access to DMA, PWM and clock registers, this is only needed once
+  double start = dma_now();
+  if(!dma_conf.hal) {
+    dma_conf.hal = hal_get();
+    if(dma_conf.hal->init() != 0) {
+      fprintf(stderr, "Failed to initialize %s backend\n", dma_conf.hal->name);
+      exit(-1);
+    }
+    uint8_t *cm_base_ptr = dma_conf.hal->map_peripheral(CM_BASE, CM_LEN);
+    clk_reg = (CLKCtrlReg *)(cm_base_ptr + CM_PWM);
+    pwm_reg = dma_conf.hal->map_peripheral(PWM_BASE, PWM_LEN);
+  }
 
   // enable rate limiting if the argument is not zero
+  dma_conf.throttled = (rate != 0);
   if(rate) {
     // calculate the clock divider and PWM timer count
-    // TODO calculate both to get some range of frequently used sample rates
-    unsigned int div = 10; // 750 MHz / 10 = 75 MHz PWM clock
-    unsigned int range = CLK_PLLD_FREQ / (div * rate);  // for 5 MHz rate, range = 15
-    dma_conf.num_cbs *= 2;
+    if(dma_solve_clock(rate, &dma_conf.clock) != 0) {
+      fprintf(stderr, "Sample rate %u Hz can not be reached\n", rate);
+      exit(-1);
+    }
+    // with the sample rate limited, a small ring is enough to keep ahead of DMA
+    // this way memory use does not depend on the capture length
+    dma_conf.ring = (num_samples > DMA_RING_SAMPLES);
+    if(dma_conf.ring) {
+      // one more lap than needed, so that a saturated count is always past the end of the capture
+      dma_conf.buff_len = DMA_RING_SAMPLES;
+      dma_conf.num_laps = (num_samples + DMA_RING_SAMPLES - 1) / DMA_RING_SAMPLES + 1;
+    }
+    dma_conf.cbs_per_sample = 2;
 
-    init_hw_clk(div);
+    init_hw_clk(&dma_conf.clock);
     usleep(100);
 
-    init_pwm(range);
+    init_pwm(dma_conf.clock.range);
     usleep(100);
+  } else if(dma_conf.opts.timestamps) {
+    // one extra block per interval, and one at the very end
+    dma_conf.num_timestamps = (num_samples + DMA_TIMESTAMP_INTERVAL - 1) / DMA_TIMESTAMP_INTERVAL + 1;
   }
+  dma_conf.num_cbs = dma_conf.buff_len * dma_conf.cbs_per_sample + dma_conf.num_timestamps + (dma_conf.ring ? 1 : 0);
+
+  dma_conf.timing.map = dma_now() - start;
 
   // allocate buffers based on the number of samples requested by the user
+  start = dma_now();
   dma_alloc_buffers();
   usleep(100);
+  dma_conf.timing.alloc = dma_now() - start;
 
   // initialize control blocks
+  start = dma_now();
   dma_init_cbs(rate != 0);
   usleep(100);
+  dma_conf.timing.init_cbs = dma_now() - start;
 }
 
-void* dma_get_samp_ptr(size_t offset) { return(dma_buff_virt_addr(dma_conf.dma_samples, offset, sizeof(uint32_t))); }
+size_t dma_get_mem_size() {
+  return(dma_conf.samples_mem.size + dma_conf.cbs_mem.size + dma_conf.timestamps_mem.size + dma_conf.laps_mem.size);
+}
+
+size_t dma_get_progress() {
+  // the channel is idle before start and after the last control block, or when it stopped on an error
+  uint32_t cb_addr = dma_conf.hal ? dma_conf.hal->dma_get_cb() : 0;
+  if(cb_addr == 0) {
+    if(!dma_conf.started || dma_failed()) {
+      return(dma_conf.progress);
+    }
+    return(dma_conf.num_samples);
+  }
+
+  // in a ring, the lap count is only consistent with the control block if no lap ended while reading it
+  uint32_t cb_base = dma_buff_bus_addr(dma_conf.dma_cbs, 0, sizeof(DMAControlBlock));
+  size_t laps = 0;
+  if(dma_conf.ring) {
+    const volatile DMAControlBlock* lap = (DMAControlBlock*)dma_buff_virt_addr(dma_conf.dma_cbs, dma_conf.lap_cb, sizeof(DMAControlBlock));
+    uint32_t lap_addr = cb_base + dma_conf.lap_cb * sizeof(DMAControlBlock);
+    uint32_t laps_base = dma_buff_bus_addr(dma_conf.dma_laps, 0, sizeof(uint32_t));
+    int retries = 0;
+    for(;; retries++) {
+      if(retries >= DMA_PROGRESS_RETRIES) {
+        return(dma_conf.progress);
+      }
+      laps = (lap->src - laps_base) / sizeof(uint32_t);
+      uint32_t cb_after = dma_conf.hal->dma_get_cb();
+      if((cb_addr != lap_addr) && (cb_after != lap_addr) && (cb_after >= cb_addr)) {
+        break;
+      }
+      cb_addr = cb_after;
+      if(cb_addr == 0) {
+        return(dma_conf.progress);
+      }
+    }
+  }
+
+  // all samples before the control block currently being processed are done
+  size_t cb_idx = (cb_addr - cb_base) / sizeof(DMAControlBlock);
+  size_t done = cb_idx / dma_conf.cbs_per_sample;
+  if(dma_conf.num_timestamps) {
+    // every interval starts with a timestamp block
+    size_t period = DMA_TIMESTAMP_INTERVAL + 1;
+    done = (cb_idx / period) * DMA_TIMESTAMP_INTERVAL + ((cb_idx % period) ? (cb_idx % period) - 1 : 0);
+  }
+
+  // the ring keeps going until stopped, so the position is not clamped there and overwritten samples can be detected
+  if(dma_conf.ring) {
+    dma_conf.progress = laps * dma_conf.buff_len + done;
+  } else {
+    dma_conf.progress = (done > dma_conf.num_samples) ? dma_conf.num_samples : done;
+  }
+  return(dma_conf.progress);
+}
+
+bool dma_failed() {
+  return(dma_conf.started && dma_conf.hal->dma_get_error());
+}
+
+void* dma_get_samp_ptr(size_t offset) { return(dma_buff_virt_addr(dma_conf.dma_samples, offset % dma_conf.buff_len, dma_conf.sample_words * sizeof(uint32_t))); }
+
+size_t dma_get_buff_len() { return(dma_conf.buff_len); }
+
+unsigned int dma_get_sample_words() { return(dma_conf.sample_words); }
+
+void dma_get_timing(struct dma_timing_t* timing) { *timing = dma_conf.timing; }
+
+size_t dma_get_timestamps(const uint32_t** timestamps) {
+  *timestamps = dma_conf.num_timestamps ? (const uint32_t*)dma_conf.dma_timestamps->virtual_addr : NULL;
+  return(dma_conf.num_timestamps);
+}
+
+bool dma_get_clock(struct dma_clock_t* clk) {
+  *clk = dma_conf.clock;
+  return(dma_conf.throttled);
+}
@@ -2,10 +2,80 @@
 #define DMA_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-void dma_init(size_t num_samples, unsigned int rate);
+// number of samples between system timer timestamps
+#define DMA_TIMESTAMP_INTERVAL  (256)
+
+struct dma_opts_t {
+  // AXI bus priority of normal and panicking transfers, 0 - 15
+  unsigned int priority;
+  unsigned int panic_priority;
+
+  // wait for the write response before moving to the next transfer
+  bool wait_resp;
+
+  // record the 1 MHz system timer every DMA_TIMESTAMP_INTERVAL samples, only without rate limiting
+  bool timestamps;
+
+  // sample GPIO bank 1 (GPIO 32 - 53) as well, every sample is then two words: GPLEV0 and GPLEV1
+  bool bank1;
+};
+
+#define DMA_OPTS_DEFAULT { .priority = 8, .panic_priority = 8, .wait_resp = true, .timestamps = false, .bank1 = false }
+
+// PWM clock configuration used to pace the samples
+struct dma_clock_t {
+  // clock source (CLK_CTL_SRC_OSC or CLK_CTL_SRC_PLLD) and its frequency in Hz
+  unsigned int src;
+  double src_freq;
+
+  // integer and fractional divider, fractional part is only used with MASH filter enabled
+  unsigned int divi;
+  unsigned int divf;
+  unsigned int mash;
+
+  // PWM range, one sample is taken every range cycles of the divided clock
+  unsigned int range;
+
+  // requested and resulting sample rate in Hz
+  double rate_requested;
+  double rate;
+};
+
+// find the clock source, divider and PWM range that get closest to the requested sample rate
+// returns 0 on success, -1 if the rate can not be reached at all
+int dma_solve_clock(double rate, struct dma_clock_t* clk);
+
+// time spent in the individual steps of dma_init, in seconds
+struct dma_timing_t {
+  double map;
+  double alloc;
+  double init_cbs;
+};
+
+// set up the control blocks for a capture, can be called again after dma_end, opts may be NULL for defaults
+void dma_init(size_t num_samples, unsigned int rate, const struct dma_opts_t* opts);
 void dma_start();
 void dma_end();
+// number of samples written so far, in a ring this keeps counting past the capture length until dma_end
+size_t dma_get_progress();
+// true if the channel stopped on an error, the samples after dma_get_progress() were never captured
+bool dma_failed();
+size_t dma_get_mem_size();
+// pointer to sample at offset from the start of capture, buffer wraps around every dma_get_buff_len() samples
 void* dma_get_samp_ptr(size_t offset);
+size_t dma_get_buff_len();
+
+// number of 32-bit words per sample, 2 when sampling both GPIO banks
+unsigned int dma_get_sample_words();
+void dma_get_timing(struct dma_timing_t* timing);
+
+// get the clock configuration, returns false if the capture is not rate limited
+bool dma_get_clock(struct dma_clock_t* clk);
+
+// get the recorded timestamps in microseconds, returns their number
+size_t dma_get_timestamps(const uint32_t** timestamps);
 
 #endif
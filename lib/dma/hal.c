@@ -0,0 +1,19 @@
+/*
+  Backend selection, the real hardware is used unless the simulation is requested
+*/
+
+#include "hal.h"
+
+static const HALBackend* hal = &hal_bcm;
+
+const HALBackend* hal_get() {
+  return(hal);
+}
+
+int hal_use_sim(const char* script) {
+  if(hal_sim_load(script) != 0) {
+    return(-1);
+  }
+  hal = &hal_sim;
+  return(0);
+}
@@ -0,0 +1,63 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+typedef struct DMAControlBlock {
+  uint32_t tx_info;    // Transfer information
+  uint32_t src;        // Source (bus) address
+  uint32_t dest;       // Destination (bus) address
+  uint32_t tx_len;     // Transfer length (in bytes)
+  uint32_t stride;     // 2D stride
+  uint32_t next_cb;    // Next DMAControlBlock (bus) address
+  uint32_t padding[2]; // 2-word padding
+} DMAControlBlock;
+
+typedef struct DMAMemHandle {
+  void *virtual_addr; // Virutal base address of the page
+  uint32_t bus_addr;  // Bus adress of the page, this is not a pointer because it does not point to valid virtual address
+  uint32_t mb_handle; // Used by mailbox property interface
+  uint32_t size;
+} DMAMemHandle;
+
+// hardware abstraction, everything that touches the peripherals goes through this
+typedef struct HALBackend {
+  const char* name;
+
+  // set up access to DMA channel and GPIO, returns 0 on success
+  int (*init)(void);
+
+  // map peripheral registers at offset from the peripheral base
+  void* (*map_peripheral)(uint32_t offset, uint32_t size);
+
+  // allocate memory accessible by the DMA engine, size is a multiple of page size
+  int (*mem_alloc)(DMAMemHandle* mem, uint32_t size);
+  void (*mem_free)(DMAMemHandle* mem);
+
+  // start processing control blocks at bus address cb_addr, with the given channel CS flags
+  void (*dma_start)(uint32_t cb_addr, uint32_t cs_flags);
+  void (*dma_stop)(void);
+
+  // bus address of the control block being processed, 0 when the channel is idle
+  uint32_t (*dma_get_cb)(void);
+
+  // non-zero if the channel stopped on an error instead of reaching the end of the chain
+  int (*dma_get_error)(void);
+
+  // read GPIO level register of bank 0 (GPIO 0 - 31) or 1 (GPIO 32 - 53)
+  uint32_t (*gpio_read)(unsigned int bank);
+} HALBackend;
+
+extern const HALBackend hal_bcm;
+extern const HALBackend hal_sim;
+
+// load waveforms of the simulated backend from a script file, returns 0 on success
+int hal_sim_load(const char* script);
+
+// currently selected backend, defaults to the real hardware
+const HALBackend* hal_get();
+
+// use the simulated backend with waveforms from a script file, must be called before dma_init
+int hal_use_sim(const char* script);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+  Real hardware backend, peripherals are accessed via /dev/mem and /dev/gpiomem,
+  DMA memory is allocated from the VideoCore via mailbox (/dev/vcio)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "mailbox.h"
+#include "hal.h"
+#include "registers.h"
+
+typedef struct DMACtrlReg {
+  uint32_t cs;      // DMA Channel Control and Status register
+  uint32_t cb_addr; // DMA Channel Control Block Address
+} DMACtrlReg;
+
+static volatile DMACtrlReg *dma_reg = NULL;
+static volatile uint32_t *gpio_reg = NULL;
+static int mailbox_fd = -1;
+
+static void *bcm_map_peripheral(uint32_t addr, uint32_t size) {
+  int mem_fd;
+
+  // Check mem(4) about /dev/mem
+  if((mem_fd = open("/dev/mem", O_RDWR | O_SYNC)) < 0) {
+    perror("Failed to open /dev/mem: ");
+    exit(-1);
+  }
+
+  uint32_t *result = (uint32_t *)mmap(
+      NULL,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      mem_fd,
+      PERI_PHYS_BASE + addr);
+
+  close(mem_fd);
+
+  if (result == MAP_FAILED) {
+    perror("mmap error: ");
+    exit(-1);
+  }
+
+  return(result);
+}
+
+static int bcm_init(void) {
+  // GPIO is accessed via gpiomem, which does not need the full /dev/mem access
+  int fd = open("/dev/gpiomem", O_RDWR | O_SYNC);
+  if(fd < 0) {
+    fprintf(stderr, "Failed to open GPIO device!\n");
+    return(-1);
+  }
+
+  gpio_reg = (uint32_t *)mmap(0, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, PERIPH_ADDR(GPIO_BASE));
+  close(fd);
+  if(gpio_reg == MAP_FAILED) {
+    fprintf(stderr, "Failed to map GPIO device!\n");
+    gpio_reg = NULL;
+    return(-1);
+  }
+
+  uint8_t *dma_base_ptr = bcm_map_peripheral(DMA_BASE, PAGE_SIZE);
+  dma_reg = (DMACtrlReg *)(dma_base_ptr + DMA_CHANNEL * 0x100);
+  return(0);
+}
+
+static int bcm_mem_alloc(DMAMemHandle *mem, uint32_t size) {
+  if(mailbox_fd < 0) {
+    mailbox_fd = mbox_open();
+    if(mailbox_fd < 0) {
+      return(-1);
+    }
+  }
+
+  // Documentation: https://github.com/raspberrypi/firmware/wiki/Mailbox-property-interface
+  mem->mb_handle = mem_alloc(mailbox_fd, size, PAGE_SIZE, MEM_FLAG_L1_NONALLOCATING);
+  mem->bus_addr = mem_lock(mailbox_fd, mem->mb_handle);
+  if(mem->bus_addr == 0) {
+    mem_free(mailbox_fd, mem->mb_handle);
+    return(-1);
+  }
+  mem->virtual_addr = mapmem(BUS_TO_PHYS(mem->bus_addr), size);
+  mem->size = size;
+  return(0);
+}
+
+static void bcm_mem_free(DMAMemHandle *mem) {
+  unmapmem(mem->virtual_addr, mem->size);
+  mem_unlock(mailbox_fd, mem->mb_handle);
+  mem_free(mailbox_fd, mem->mb_handle);
+}
+
+static void bcm_dma_start(uint32_t cb_addr, uint32_t cs_flags) {
+  // reset the DMA channel
+  dma_reg->cs = DMA_CHANNEL_ABORT;
+  dma_reg->cs = 0;
+  dma_reg->cs = DMA_CHANNEL_RESET;
+  dma_reg->cb_addr = 0;
+
+  dma_reg->cs = DMA_INTERRUPT_STATUS | DMA_END_FLAG;
+
+  // make cb_addr point to the first DMA control block and enable DMA transfer
+  dma_reg->cb_addr = cb_addr;
+  dma_reg->cs = cs_flags;
+  dma_reg->cs |= DMA_WAIT_ON_WRITES | DMA_ACTIVE;
+}
+
+static void bcm_dma_stop(void) {
+  if(!dma_reg) {
+    return;
+  }
+
+  // shutdown DMA channel
+  dma_reg->cs |= DMA_CHANNEL_ABORT;
+  usleep(100);
+  dma_reg->cs &= ~DMA_ACTIVE;
+  dma_reg->cs |= DMA_CHANNEL_RESET;
+  usleep(100);
+}
+
+static uint32_t bcm_dma_get_cb(void) {
+  return(dma_reg->cb_addr);
+}
+
+static int bcm_dma_get_error(void) {
+  return((dma_reg->cs & DMA_ERROR) != 0);
+}
+
+static uint32_t bcm_gpio_read(unsigned int bank) {
+  return(*(gpio_reg + (GPLEV0 + 4*bank)/sizeof(uint32_t)));
+}
+
+const HALBackend hal_bcm = {
+  .name = "bcm",
+  .init = bcm_init,
+  .map_peripheral = bcm_map_peripheral,
+  .mem_alloc = bcm_mem_alloc,
+  .mem_free = bcm_mem_free,
+  .dma_start = bcm_dma_start,
+  .dma_stop = bcm_dma_stop,
+  .dma_get_cb = bcm_dma_get_cb,
+  .dma_get_error = bcm_dma_get_error,
+  .gpio_read = bcm_gpio_read,
+};
@@ -0,0 +1,430 @@
+/*
+  Simulated backend, allows running the whole capture chain without a Raspberry Pi.
+
+  Peripheral registers and DMA memory are ordinary memory. When DMA is started, a thread walks the control blocks
+  just like the DMA engine would, GPIO level reads return values of scripted waveforms. Transfers paced
+  by the PWM DREQ are timed using the PWM clock and range written by the DMA setup code, all others are done
+  at a configurable rate. Everything is synchronized to the wall clock, so the simulated capture takes as long
+  as a real one.
+
+  The waveform script is a text file, one statement per line, # starts a comment:
+    rate <Hz>                               unthrottled DMA transfer rate, defaults to 5 MHz
+    <pin> const <0|1>                       constant level
+    <pin> clock <Hz> [duty] [phase]         square wave, duty cycle 0 - 1, phase in seconds
+    <pin> pattern <Hz> <bits>               repeating sequence of 0/1 characters at the given bit rate
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "hal.h"
+#include "registers.h"
+
+#define SIM_RATE_DEFAULT      5000000.0
+#define SIM_PINS_MAX          54
+#define SIM_REGIONS_MAX       16
+
+// fake bus addresses of the simulated DMA memory
+#define SIM_BUS_BASE          0x40000000UL
+
+// do not let the simulation run more than this ahead of the wall clock
+#define SIM_LEAD_MAX          0.001
+
+enum sim_wave_e {
+  SIM_WAVE_NONE = 0,
+  SIM_WAVE_CONST,
+  SIM_WAVE_CLOCK,
+  SIM_WAVE_PATTERN,
+};
+
+struct sim_wave_t {
+  enum sim_wave_e type;
+  double freq;
+  double duty;
+  double phase;
+  int level;
+  char* bits;
+  size_t num_bits;
+};
+
+struct sim_region_t {
+  uint32_t addr;
+  uint32_t size;
+  uint8_t* ptr;
+
+  // bus address range reserved for the slot, kept when the memory is freed
+  uint32_t span;
+};
+
+static struct sim_t {
+  double rate;
+  struct sim_wave_t waves[SIM_PINS_MAX];
+  struct timespec epoch;
+
+  // peripheral register pages and DMA memory
+  struct sim_region_t periphs[SIM_REGIONS_MAX];
+  int num_periphs;
+  struct sim_region_t mems[SIM_REGIONS_MAX];
+  int num_mems;
+  uint32_t next_bus;
+
+  // DMA engine
+  pthread_t thread;
+  bool running;
+  atomic_bool stop;
+  _Atomic uint32_t cb_addr;
+  atomic_bool error;
+  uint32_t start_cb;
+} sim = {
+  .rate = SIM_RATE_DEFAULT,
+  .num_periphs = 0,
+  .num_mems = 0,
+  .next_bus = SIM_BUS_BASE,
+  .running = false,
+};
+
+static double sim_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((double)(ts.tv_sec - sim.epoch.tv_sec) + (double)(ts.tv_nsec - sim.epoch.tv_nsec)/1.0e9);
+}
+
+static int sim_wave_level(const struct sim_wave_t* w, double t) {
+  switch(w->type) {
+    case SIM_WAVE_CONST:
+      return(w->level);
+    case SIM_WAVE_CLOCK: {
+      double pos = t*w->freq + w->phase*w->freq;
+      return((pos - floor(pos)) < w->duty);
+    }
+    case SIM_WAVE_PATTERN:
+      return(w->bits[(uint64_t)(t*w->freq) % w->num_bits] == '1');
+    default:
+      return(0);
+  }
+}
+
+static uint32_t sim_levels(unsigned int bank, double t) {
+  uint32_t val = 0;
+  for(int i = 0; i < 32; i++) {
+    int pin = 32*bank + i;
+    if((pin < SIM_PINS_MAX) && sim_wave_level(&sim.waves[pin], t)) {
+      val |= (1UL << i);
+    }
+  }
+  return(val);
+}
+
+static uint32_t* sim_periph_reg(uint32_t offset) {
+  for(int i = 0; i < sim.num_periphs; i++) {
+    struct sim_region_t* r = &sim.periphs[i];
+    if((offset >= r->addr) && (offset < r->addr + r->size)) {
+      return((uint32_t*)&r->ptr[offset - r->addr]);
+    }
+  }
+  return(NULL);
+}
+
+static uint8_t* sim_bus_to_virt(uint32_t addr) {
+  for(int i = 0; i < sim.num_mems; i++) {
+    struct sim_region_t* r = &sim.mems[i];
+    if((addr >= r->addr) && (addr < r->addr + r->size)) {
+      return(&r->ptr[addr - r->addr]);
+    }
+  }
+  return(NULL);
+}
+
+// period of the PWM DREQ, as configured in the simulated clock manager and PWM registers
+static double sim_pace_period() {
+  uint32_t* ctrl = sim_periph_reg(CM_BASE + CM_PWM);
+  uint32_t* div = sim_periph_reg(CM_BASE + CM_PWM + 4);
+  uint32_t* range = sim_periph_reg(PWM_BASE + PWM_RNG1);
+  if(!ctrl || !div || !range || !*range) {
+    return(1.0 / sim.rate);
+  }
+
+  double src = ((*ctrl & 0xF) == CLK_CTL_SRC_OSC) ? CLK_OSC_FREQ : CLK_PLLD_FREQ;
+  double divider = (double)((*div >> 12) & 0xFFF) + (double)(*div & 0xFFF)/4096.0;
+  if(divider < 1.0) {
+    return(1.0 / sim.rate);
+  }
+  return((divider * (*range)) / src);
+}
+
+static void* sim_dma_thread(void* arg) {
+  (void)arg;
+  double t = sim_now();
+  double pace = sim_pace_period();
+  double next_tick = t;
+  uint32_t gplev0 = PERI_BUS_BASE + GPIO_BASE + GPLEV0;
+  uint32_t syst_clo = PERI_BUS_BASE + SYST_BASE + SYST_CLO;
+  unsigned int words = 0;
+
+  uint32_t addr = sim.start_cb;
+  while(addr && !atomic_load_explicit(&sim.stop, memory_order_relaxed)) {
+    atomic_store_explicit(&sim.cb_addr, addr, memory_order_release);
+    DMAControlBlock* cb = (DMAControlBlock*)sim_bus_to_virt(addr);
+    if(!cb) {
+      fprintf(stderr, "Simulated DMA: invalid control block address %08X\n", addr);
+      atomic_store(&sim.error, true);
+      break;
+    }
+
+    bool paced = (cb->tx_info & (DMA_SRC_DREQ | DMA_DEST_DREQ)) && ((cb->tx_info & DMA_PERIPHERAL_MAPPING(0x1F)) == DMA_PERIPHERAL_MAPPING(5));
+    uint32_t src = cb->src;
+    uint32_t dest = cb->dest;
+    for(uint32_t i = 0; i < cb->tx_len/4; i++) {
+      if(paced) {
+        // wait for room in the PWM FIFO
+        if(next_tick > t) { t = next_tick; }
+        next_tick = t + pace;
+      } else if(i == 0) {
+        // unpaced transfers take the same time regardless of length, so both GPIO banks are read at once
+        t += 1.0 / sim.rate;
+      }
+
+      uint32_t val = 0;
+      if((src == gplev0) || (src == gplev0 + 4)) {
+        val = sim_levels(src - gplev0 ? 1 : 0, t);
+      } else if(src == syst_clo) {
+        val = (uint32_t)(uint64_t)(t * 1.0e6);
+      } else {
+        uint8_t* ptr = sim_bus_to_virt(src);
+        if(ptr) { memcpy(&val, ptr, sizeof(val)); }
+      }
+
+      uint8_t* ptr = sim_bus_to_virt(dest);
+      if(ptr) { memcpy(ptr, &val, sizeof(val)); }
+
+      if(cb->tx_info & DMA_SRC_INC) { src += 4; }
+      if(cb->tx_info & DMA_DEST_INC) { dest += 4; }
+
+      // keep in sync with the wall clock
+      if((++words % 256) == 0) {
+        double lead = t - sim_now();
+        if(lead > SIM_LEAD_MAX) {
+          usleep(lead * 1.0e6);
+        }
+      }
+    }
+
+    addr = cb->next_cb;
+  }
+
+  atomic_store_explicit(&sim.cb_addr, 0, memory_order_release);
+  return(NULL);
+}
+
+static int sim_parse_line(char* line, int num) {
+  char* tok[8];
+  int n = 0;
+  for(char* s = strtok(line, " \t\r\n"); s && (n < 8); s = strtok(NULL, " \t\r\n")) {
+    if(s[0] == '#') { break; }
+    tok[n++] = s;
+  }
+
+  if(n == 0) {
+    return(0);
+  }
+
+  if(strcmp(tok[0], "rate") == 0) {
+    if((n < 2) || ((sim.rate = atof(tok[1])) <= 0)) {
+      goto fail;
+    }
+    return(0);
+  }
+
+  int pin = atoi(tok[0]);
+  if((n < 3) || (pin < 0) || (pin >= SIM_PINS_MAX)) {
+    goto fail;
+  }
+
+  struct sim_wave_t* w = &sim.waves[pin];
+  memset(w, 0, sizeof(*w));
+  if(strcmp(tok[1], "const") == 0) {
+    w->type = SIM_WAVE_CONST;
+    w->level = (atoi(tok[2]) != 0);
+  } else if(strcmp(tok[1], "clock") == 0) {
+    w->type = SIM_WAVE_CLOCK;
+    w->freq = atof(tok[2]);
+    w->duty = (n > 3) ? atof(tok[3]) : 0.5;
+    w->phase = (n > 4) ? atof(tok[4]) : 0;
+  } else if(strcmp(tok[1], "pattern") == 0) {
+    if(n < 4) {
+      goto fail;
+    }
+    w->type = SIM_WAVE_PATTERN;
+    w->freq = atof(tok[2]);
+    w->bits = strdup(tok[3]);
+    w->num_bits = strlen(tok[3]);
+  } else {
+    goto fail;
+  }
+
+  if(((w->type == SIM_WAVE_CLOCK) || (w->type == SIM_WAVE_PATTERN)) && (w->freq <= 0)) {
+    goto fail;
+  }
+  return(0);
+
+fail:
+  fprintf(stderr, "Invalid statement on line %d of simulation script\n", num);
+  return(-1);
+}
+
+static int sim_load_script(const char* path) {
+  FILE* fp = fopen(path, "r");
+  if(!fp) {
+    fprintf(stderr, "Failed to open simulation script %s\n", path);
+    return(-1);
+  }
+
+  char line[1024];
+  int num = 0;
+  int ret = 0;
+  while(fgets(line, sizeof(line), fp) && (ret == 0)) {
+    ret = sim_parse_line(line, ++num);
+  }
+  fclose(fp);
+  return(ret);
+}
+
+static int sim_init(void) {
+  clock_gettime(CLOCK_MONOTONIC, &sim.epoch);
+  return(0);
+}
+
+static void* sim_map_peripheral(uint32_t addr, uint32_t size) {
+  if(sim.num_periphs >= SIM_REGIONS_MAX) {
+    fprintf(stderr, "Simulated backend: too many peripheral mappings\n");
+    exit(-1);
+  }
+
+  struct sim_region_t* r = &sim.periphs[sim.num_periphs++];
+  r->addr = addr;
+  r->size = size;
+  r->ptr = calloc(1, size);
+  return(r->ptr);
+}
+
+static int sim_mem_alloc(DMAMemHandle* mem, uint32_t size) {
+  // reuse slots of freed blocks, preferably one with a large enough address range
+  int idx = -1;
+  for(int i = 0; i < sim.num_mems; i++) {
+    if(!sim.mems[i].ptr && ((idx < 0) || (sim.mems[i].span >= size))) {
+      idx = i;
+    }
+  }
+  if(idx < 0) {
+    idx = sim.num_mems;
+  }
+  if(idx >= SIM_REGIONS_MAX) {
+    return(-1);
+  }
+
+  // new addresses must stay below the simulated peripherals
+  struct sim_region_t* r = &sim.mems[idx];
+  bool reuse = (idx < sim.num_mems) && (r->span >= size);
+  if(!reuse && (size > PERI_BUS_BASE - sim.next_bus)) {
+    fprintf(stderr, "Simulated backend: out of bus address space\n");
+    return(-1);
+  }
+
+  if(posix_memalign((void**)&r->ptr, PAGE_SIZE, size) != 0) {
+    r->ptr = NULL;
+    return(-1);
+  }
+  memset(r->ptr, 0, size);
+  if(!reuse) {
+    r->addr = sim.next_bus;
+    r->span = size;
+    sim.next_bus += size;
+  }
+  r->size = size;
+  if(idx == sim.num_mems) { sim.num_mems++; }
+
+  mem->virtual_addr = r->ptr;
+  mem->bus_addr = r->addr;
+  mem->mb_handle = idx + 1;
+  mem->size = size;
+  return(0);
+}
+
+static void sim_mem_free(DMAMemHandle* mem) {
+  for(int i = 0; i < sim.num_mems; i++) {
+    if(sim.mems[i].ptr == mem->virtual_addr) {
+      free(sim.mems[i].ptr);
+      sim.mems[i].ptr = NULL;
+      sim.mems[i].size = 0;
+    }
+  }
+
+  // once everything is freed, addresses can start over
+  for(int i = 0; i < sim.num_mems; i++) {
+    if(sim.mems[i].ptr) {
+      return;
+    }
+  }
+  sim.num_mems = 0;
+  sim.next_bus = SIM_BUS_BASE;
+}
+
+static void sim_dma_stop(void) {
+  if(sim.running) {
+    atomic_store(&sim.stop, true);
+    pthread_join(sim.thread, NULL);
+    sim.running = false;
+  }
+  atomic_store(&sim.cb_addr, 0);
+}
+
+static void sim_dma_start(uint32_t cb_addr, uint32_t cs_flags) {
+  (void)cs_flags;
+  sim_dma_stop();
+
+  sim.start_cb = cb_addr;
+  atomic_store(&sim.stop, false);
+  atomic_store(&sim.error, false);
+  atomic_store(&sim.cb_addr, cb_addr);
+  sim.running = (pthread_create(&sim.thread, NULL, sim_dma_thread, NULL) == 0);
+  if(!sim.running) {
+    atomic_store(&sim.cb_addr, 0);
+  }
+}
+
+static uint32_t sim_dma_get_cb(void) {
+  return(atomic_load_explicit(&sim.cb_addr, memory_order_acquire));
+}
+
+static int sim_dma_get_error(void) {
+  return(atomic_load(&sim.error));
+}
+
+static uint32_t sim_gpio_read(unsigned int bank) {
+  return(sim_levels(bank, sim_now()));
+}
+
+const HALBackend hal_sim = {
+  .name = "sim",
+  .init = sim_init,
+  .map_peripheral = sim_map_peripheral,
+  .mem_alloc = sim_mem_alloc,
+  .mem_free = sim_mem_free,
+  .dma_start = sim_dma_start,
+  .dma_stop = sim_dma_stop,
+  .dma_get_cb = sim_dma_get_cb,
+  .dma_get_error = sim_dma_get_error,
+  .gpio_read = sim_gpio_read,
+};
+
+int hal_sim_load(const char* script) {
+  return(sim_load_script(script));
+}
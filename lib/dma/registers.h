@@ -1,6 +1,8 @@
 #ifndef RPI_REGISTERS_H
 #define RPI_REGISTERS_H
 
+#include "board.h"
+
 /*
  * Check more about Raspberry Pi's register mapping at:
  * https://www.raspberrypi.org/app/uploads/2012/02/BCM2835-ARM-Peripherals.pdf
@@ -11,21 +13,13 @@
 #define PERI_BUS_BASE 0x7E000000
 
 /*
-BCM2835 - RPi 3
-BCM2711 - RPi 4
+Everything that differs between BCM2835 (RPi 1), BCM2836/7 (RPi 2, 3) and BCM2711 (RPi 4)
+is detected at runtime, see board.h
 */
-
-#ifdef RPI3
-#define PERI_PHYS_BASE  0x3F000000
-#define BUS_TO_PHYS(x) ((x) & ~0xC0000000)
-#define CLK_OSC_FREQ 19200000
-#define CLK_PLLD_FREQ 500000000
-#else
-#define PERI_PHYS_BASE 0xFE000000
-#define BUS_TO_PHYS(x) ((x) + 0x80000000)
-#define CLK_OSC_FREQ 54000000
-#define CLK_PLLD_FREQ 750000000
-#endif
+#define PERI_PHYS_BASE (board_get()->periph_base)
+#define BUS_TO_PHYS(x) (((x) & board_get()->bus_mask) + board_get()->bus_offset)
+#define CLK_OSC_FREQ (board_get()->osc_freq)
+#define CLK_PLLD_FREQ (board_get()->plld_freq)
 
 #define PERIPH_ADDR(X) (PERI_PHYS_BASE + X)
 
@@ -45,12 +39,18 @@ BCM2711 - RPi 4
 #define CLK_CTL_SRC_OSC 1
 #define CLK_CTL_SRC_PLLD 6
 
+#define CLK_CTL_MASH(x) ((x) << 9)
+
 #define CLK_DIV_DIVI(x) ((x) << 12)
+#define CLK_DIV_DIVF(x) ((x) << 0)
+#define CLK_DIVI_MAX 4095
+#define CLK_DIVF_MAX 4095
 
 #define BCM_PASSWD (0x5A << 24)
 
 #define PWM_BASE 0x0020C000
 #define PWM_LEN 0x28
+#define PWM_RNG1 0x10
 #define PWM_FIFO 0x18
 
 /* PWM control bits */
@@ -81,6 +81,7 @@ BCM2711 - RPi 4
 #define DMA_PRIORITY(x) ((x) << 16)
 #define DMA_INTERRUPT_STATUS (1 << 2)
 #define DMA_END_FLAG (1 << 1)
+#define DMA_ERROR (1 << 8)
 #define DMA_ACTIVE (1 << 0)
 #define DMA_DISDEBUG (1 << 28) // TODO this should be 29!
 
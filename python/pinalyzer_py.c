@@ -0,0 +1,372 @@
+/*
+  Python bindings for capturing directly into memory, without the round-trip through an output file.
+  Capture objects support the buffer protocol, numpy.asarray(cap) is a view of the samples in the
+  capture buffer, one uint32 per sample with bit N for channel N.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dma/hal.h"
+#include "dma/board.h"
+
+#include "session.h"
+#include "trigger.h"
+
+typedef struct {
+  PyObject_HEAD
+
+  // the session stays open as long as the capture, views of the samples keep a reference to it
+  struct session_t* session;
+  const struct capture_t* cap;
+  const uint32_t* samples;
+  Py_ssize_t shape[1];
+} CaptureObject;
+
+static const struct {
+  const char* name;
+  enum trig_type_e type;
+} triggers[] = {
+  { "rising", TRIG_TYPE_RISING },
+  { "falling", TRIG_TYPE_FALLING },
+  { "any", TRIG_TYPE_ANY },
+  { "immediate", TRIG_TYPE_IMMEDIATE },
+};
+
+static bool board_ready = false;
+
+static int py_init_board(const char* dt_root, const char* sim) {
+  if(sim && (hal_use_sim(sim) != 0)) {
+    PyErr_Format(PyExc_OSError, "Failed to load simulation script %s", sim);
+    return(-1);
+  }
+
+  // simulation can run without device tree
+  if(board_init(dt_root) != 0) {
+    if(!sim) {
+      PyErr_SetString(PyExc_OSError, "Failed to detect the board");
+      return(-1);
+    }
+    board_use_default();
+  }
+  board_ready = true;
+  return(0);
+}
+
+static void Capture_dealloc(CaptureObject* self) {
+  session_close(self->session);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Capture_getbuffer(CaptureObject* self, Py_buffer* view, int flags) {
+  if(flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "Capture samples are read-only");
+    return(-1);
+  }
+
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->buf = (void*)self->samples;
+  view->len = self->shape[0] * (Py_ssize_t)sizeof(uint32_t);
+  view->readonly = 1;
+  view->itemsize = sizeof(uint32_t);
+  view->format = (flags & PyBUF_FORMAT) ? "I" : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+  view->strides = NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return(0);
+}
+
+static PyBufferProcs Capture_as_buffer = {
+  .bf_getbuffer = (getbufferproc)Capture_getbuffer,
+  .bf_releasebuffer = NULL,
+};
+
+static Py_ssize_t Capture_len(CaptureObject* self) {
+  return(self->shape[0]);
+}
+
+static PySequenceMethods Capture_as_sequence = {
+  .sq_length = (lenfunc)Capture_len,
+};
+
+// indices of samples at which the channel of pin changes its level, as a memoryview of uint64
+static PyObject* Capture_transitions(CaptureObject* self, PyObject* args) {
+  int pin;
+  if(!PyArg_ParseTuple(args, "i", &pin)) {
+    return(NULL);
+  }
+
+  unsigned int ch = 0;
+  while((ch < self->cap->num_pins) && (self->cap->pins[ch] != pin)) { ch++; }
+  if(ch == self->cap->num_pins) {
+    PyErr_Format(PyExc_ValueError, "Pin %d was not captured", pin);
+    return(NULL);
+  }
+
+  // count first, so that the result can be filled in place
+  const uint32_t* samples = self->samples;
+  size_t num_samples = self->shape[0];
+  uint32_t mask = 1UL << ch;
+  size_t num = 0;
+  for(size_t i = 1; i < num_samples; i++) {
+    num += ((samples[i] ^ samples[i - 1]) & mask) != 0;
+  }
+
+  PyObject* bytes = PyByteArray_FromStringAndSize(NULL, num * sizeof(uint64_t));
+  if(!bytes) {
+    return(NULL);
+  }
+  uint64_t* idx = (uint64_t*)PyByteArray_AS_STRING(bytes);
+  num = 0;
+  for(size_t i = 1; i < num_samples; i++) {
+    if((samples[i] ^ samples[i - 1]) & mask) {
+      idx[num++] = i;
+    }
+  }
+
+  PyObject* view = PyMemoryView_FromObject(bytes);
+  Py_DECREF(bytes);
+  if(!view) {
+    return(NULL);
+  }
+  PyObject* res = PyObject_CallMethod(view, "cast", "s", "Q");
+  Py_DECREF(view);
+  return(res);
+}
+
+static PyObject* Capture_get_rate(CaptureObject* self, void* closure) {
+  (void)closure;
+  return(PyFloat_FromDouble(self->cap->samp_rate));
+}
+
+// sample rate measured over the whole capture, from the wall-clock start and end times
+static PyObject* Capture_get_measured_rate(CaptureObject* self, void* closure) {
+  (void)closure;
+  double dt = (double)(self->cap->end.tv_sec - self->cap->start.tv_sec) +
+    (double)(self->cap->end.tv_nsec - self->cap->start.tv_nsec) / 1.0e9;
+  return(PyFloat_FromDouble((dt > 0) ? (double)self->cap->num_samples / dt : 0.0));
+}
+
+static PyObject* Capture_get_pins(CaptureObject* self, void* closure) {
+  (void)closure;
+  PyObject* pins = PyTuple_New(self->cap->num_pins);
+  if(!pins) {
+    return(NULL);
+  }
+  for(unsigned int i = 0; i < self->cap->num_pins; i++) {
+    PyTuple_SET_ITEM(pins, i, PyLong_FromLong(self->cap->pins[i]));
+  }
+  return(pins);
+}
+
+static PyObject* Capture_get_labels(CaptureObject* self, void* closure) {
+  (void)closure;
+  PyObject* labels = PyTuple_New(self->cap->num_pins);
+  if(!labels) {
+    return(NULL);
+  }
+  for(unsigned int i = 0; i < self->cap->num_pins; i++) {
+    PyTuple_SET_ITEM(labels, i, PyUnicode_FromString(self->cap->labels[i]));
+  }
+  return(labels);
+}
+
+static PyMethodDef Capture_methods[] = {
+  { "transitions", (PyCFunction)Capture_transitions, METH_VARARGS, "Sample indices at which the given pin changes level, as uint64 memoryview" },
+  { NULL, NULL, 0, NULL },
+};
+
+static PyGetSetDef Capture_getset[] = {
+  { "rate", (getter)Capture_get_rate, NULL, "Configured sample rate in Sps, exact for rate-limited captures", NULL },
+  { "measured_rate", (getter)Capture_get_measured_rate, NULL, "Sample rate measured from the capture duration in Sps", NULL },
+  { "pins", (getter)Capture_get_pins, NULL, "Captured BCM pins, in channel order", NULL },
+  { "labels", (getter)Capture_get_labels, NULL, "Channel labels", NULL },
+  { NULL, NULL, NULL, NULL, NULL },
+};
+
+static PyTypeObject CaptureType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "pinalyzer.Capture",
+  .tp_doc = "Captured samples, supports the buffer protocol with one uint32 per sample",
+  .tp_basicsize = sizeof(CaptureObject),
+  .tp_itemsize = 0,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_dealloc = (destructor)Capture_dealloc,
+  .tp_as_buffer = &Capture_as_buffer,
+  .tp_as_sequence = &Capture_as_sequence,
+  .tp_methods = Capture_methods,
+  .tp_getset = Capture_getset,
+};
+
+static PyObject* py_init(PyObject* self, PyObject* args, PyObject* kwargs) {
+  (void)self;
+  static char* kwlist[] = { "dt_root", "sim", NULL };
+  const char* dt_root = NULL;
+  const char* sim = NULL;
+  if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|zz", kwlist, &dt_root, &sim)) {
+    return(NULL);
+  }
+  if(py_init_board(dt_root, sim) != 0) {
+    return(NULL);
+  }
+  Py_RETURN_NONE;
+}
+
+static PyObject* py_capture(PyObject* self, PyObject* args, PyObject* kwargs) {
+  (void)self;
+  static char* kwlist[] = { "pins", "samples", "rate", "trigger", "labels", NULL };
+  PyObject* pins_obj;
+  Py_ssize_t num_samples;
+  unsigned int rate = 0;
+  const char* trig_name = "immediate";
+  PyObject* labels_obj = NULL;
+  if(!PyArg_ParseTupleAndKeywords(args, kwargs, "On|IsO", kwlist, &pins_obj, &num_samples, &rate, &trig_name, &labels_obj)) {
+    return(NULL);
+  }
+
+  if(!board_ready && (py_init_board(NULL, NULL) != 0)) {
+    return(NULL);
+  }
+
+  struct session_conf_t conf = {
+    .rate = rate,
+    .num_samples = (num_samples > 0) ? (size_t)num_samples : 0,
+    .dma_opts = DMA_OPTS_DEFAULT,
+    .exporter = NULL,
+    .verbose = false,
+  };
+
+  size_t i = 0;
+  for(; i < sizeof(triggers)/sizeof(triggers[0]); i++) {
+    if(strcmp(triggers[i].name, trig_name) == 0) {
+      conf.trig = triggers[i].type;
+      break;
+    }
+  }
+  if(i == sizeof(triggers)/sizeof(triggers[0])) {
+    PyErr_Format(PyExc_ValueError, "Unknown trigger type: %s", trig_name);
+    return(NULL);
+  }
+
+  // pins and labels only need to live until the session is configured, it copies both
+  int pins[SESSION_PINS_MAX];
+  const char* labels[SESSION_PINS_MAX] = { NULL };
+  PyObject* pins_seq = PySequence_Fast(pins_obj, "pins must be a sequence");
+  if(!pins_seq) {
+    return(NULL);
+  }
+  Py_ssize_t num_pins = PySequence_Fast_GET_SIZE(pins_seq);
+  if((num_pins < 1) || (num_pins > SESSION_PINS_MAX)) {
+    Py_DECREF(pins_seq);
+    PyErr_Format(PyExc_ValueError, "Invalid number of capture pins: %zd", num_pins);
+    return(NULL);
+  }
+  for(Py_ssize_t p = 0; p < num_pins; p++) {
+    pins[p] = (int)PyLong_AsLong(PySequence_Fast_GET_ITEM(pins_seq, p));
+  }
+  Py_DECREF(pins_seq);
+  if(PyErr_Occurred()) {
+    return(NULL);
+  }
+  conf.pins = pins;
+  conf.num_pins = num_pins;
+
+  PyObject* labels_seq = NULL;
+  if(labels_obj && (labels_obj != Py_None)) {
+    labels_seq = PySequence_Fast(labels_obj, "labels must be a sequence");
+    if(!labels_seq) {
+      return(NULL);
+    }
+    for(Py_ssize_t l = 0; (l < PySequence_Fast_GET_SIZE(labels_seq)) && (l < num_pins); l++) {
+      labels[l] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(labels_seq, l));
+      if(!labels[l]) {
+        Py_DECREF(labels_seq);
+        return(NULL);
+      }
+    }
+  }
+  conf.labels = labels;
+
+  CaptureObject* cap = PyObject_New(CaptureObject, &CaptureType);
+  if(!cap) {
+    Py_XDECREF(labels_seq);
+    return(NULL);
+  }
+  cap->session = session_open();
+  if(!cap->session) {
+    Py_XDECREF(labels_seq);
+    PyObject_Del(cap);
+    PyErr_SetString(PyExc_RuntimeError, "Another capture is still alive, release it first");
+    return(NULL);
+  }
+
+  int ret = session_configure(cap->session, &conf);
+  Py_XDECREF(labels_seq);
+  if(ret == EXIT_SUCCESS) {
+    ret = session_arm(cap->session);
+  }
+
+  // waiting for the trigger may take a while
+  if(ret == EXIT_SUCCESS) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = session_wait(cap->session);
+    Py_END_ALLOW_THREADS
+  }
+
+  struct segment_t view;
+  if(ret == EXIT_SUCCESS) {
+    ret = session_read_samples(cap->session, 0, conf.num_samples, &view);
+  }
+  if(ret != EXIT_SUCCESS) {
+    Py_DECREF(cap);
+    PyErr_SetString(PyExc_RuntimeError, "Capture failed");
+    return(NULL);
+  }
+
+  cap->cap = session_get_capture(cap->session);
+  cap->samples = view.samples;
+  cap->shape[0] = view.len;
+  return((PyObject*)cap);
+}
+
+static PyMethodDef pinalyzer_methods[] = {
+  { "init", (PyCFunction)(void(*)(void))py_init, METH_VARARGS | METH_KEYWORDS,
+    "init(dt_root=None, sim=None)\n\nDetect the board, optionally from a device tree copy, or run on simulated hardware with the script file." },
+  { "capture", (PyCFunction)(void(*)(void))py_capture, METH_VARARGS | METH_KEYWORDS,
+    "capture(pins, samples, rate=0, trigger='immediate', labels=None)\n\nCapture samples of the pins into memory, rate 0 is the board default." },
+  { NULL, NULL, 0, NULL },
+};
+
+static struct PyModuleDef pinalyzer_module = {
+  PyModuleDef_HEAD_INIT,
+  .m_name = "pinalyzer",
+  .m_doc = "RPi GPIO logic analyzer",
+  .m_size = -1,
+  .m_methods = pinalyzer_methods,
+};
+
+PyMODINIT_FUNC PyInit_pinalyzer(void) {
+  if(PyType_Ready(&CaptureType) < 0) {
+    return(NULL);
+  }
+
+  PyObject* mod = PyModule_Create(&pinalyzer_module);
+  if(!mod) {
+    return(NULL);
+  }
+
+  Py_INCREF(&CaptureType);
+  if(PyModule_AddObject(mod, "Capture", (PyObject*)&CaptureType) < 0) {
+    Py_DECREF(&CaptureType);
+    Py_DECREF(mod);
+    return(NULL);
+  }
+  return(mod);
+}
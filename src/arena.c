@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+// arena size is rounded up to whole hugepages
+#define ARENA_HUGEPAGE_SIZE   (2UL*1024UL*1024UL)
+
+static struct arena_t arena_shared = {
+  .base = NULL,
+  .size = 0,
+  .used = 0,
+  .huge = false,
+};
+
+static _Thread_local struct arena_t* arena = &arena_shared;
+
+void arena_select(struct arena_t* a) {
+  arena = a ? a : &arena_shared;
+}
+
+int arena_init(size_t size) {
+  size = ((size + ARENA_HUGEPAGE_SIZE - 1) / ARENA_HUGEPAGE_SIZE) * ARENA_HUGEPAGE_SIZE;
+
+  // try explicit hugepages first, these are only available if reserved by the system
+  void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+  arena->huge = (ptr != MAP_FAILED);
+  if(!arena->huge) {
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED) {
+      fprintf(stderr, "Failed to reserve %lu bytes for the arena\n", size);
+      return(EXIT_FAILURE);
+    }
+
+    // at least ask for transparent hugepages, then fault everything in now rather than during capture
+    madvise(ptr, size, MADV_HUGEPAGE);
+    memset(ptr, 0, size);
+  }
+
+  // keep it resident, this may fail without root privileges which is fine
+  mlock(ptr, size);
+
+  arena->base = ptr;
+  arena->size = size;
+  arena->used = 0;
+  return(EXIT_SUCCESS);
+}
+
+void arena_free() {
+  if(!arena->base) {
+    return;
+  }
+
+  munmap(arena->base, arena->size);
+  arena->base = NULL;
+  arena->size = 0;
+  arena->used = 0;
+  arena->huge = false;
+}
+
+void* arena_alloc(size_t size, size_t align) {
+  size_t start = ((arena->used + align - 1) / align) * align;
+  if(!arena->base || (start + size > arena->size)) {
+    fprintf(stderr, "Arena exhausted, %lu bytes requested, %lu of %lu used\n", size, arena->used, arena->size);
+    return(NULL);
+  }
+
+  arena->used = start + size;
+  memset(&arena->base[start], 0, size);
+  return(&arena->base[start]);
+}
+
+size_t arena_mark() {
+  return(arena->used);
+}
+
+void arena_release(size_t mark) {
+  if(mark < arena->used) {
+    arena->used = mark;
+  }
+}
+
+size_t arena_size() {
+  return(arena->size);
+}
+
+size_t arena_used() {
+  return(arena->used);
+}
+
+bool arena_is_huge() {
+  return(arena->huge);
+}
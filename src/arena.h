@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// default alignment of arena allocations
+#define ARENA_ALIGN_DEFAULT   (64)
+
+// all threads share a single arena, unless they select their own
+struct arena_t {
+  uint8_t* base;
+  size_t size;
+  size_t used;
+  bool huge;
+};
+
+// make the calling thread use arena a for all the functions below, NULL for the shared one
+void arena_select(struct arena_t* a);
+
+// reserve the whole arena up front, backed by hugepages if possible
+int arena_init(size_t size);
+
+// unmap the arena, everything allocated from it becomes invalid
+void arena_free();
+
+// allocate zeroed block from the arena, returns NULL if the arena is exhausted
+void* arena_alloc(size_t size, size_t align);
+
+// remember the current fill level, and later release everything allocated after it
+size_t arena_mark();
+void arena_release(size_t mark);
+
+size_t arena_size();
+size_t arena_used();
+bool arena_is_huge();
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// description of a single capture, shared by all the processing stages
+struct capture_t {
+  // number of captured channels and their BCM pin numbers
+  unsigned int num_pins;
+  const int* pins;
+
+  // channel labels, always valid for all channels
+  const char* const* labels;
+
+  // total number of samples and the sampling rate in Hz
+  size_t num_samples;
+  double samp_rate;
+
+  // index of the sample at which the trigger occured
+  size_t trig_idx;
+
+  // wall-clock time when the capture was started and finished
+  struct timespec start;
+  struct timespec end;
+};
+
+// a contiguous block of converted samples
+// every sample is a single word where bit N is the state of channel N
+struct segment_t {
+  const uint32_t* samples;
+  size_t offset;
+  size_t len;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "compare.h"
+
+int compare_load(const char* path, struct compare_ref_t* ref) {
+  memset(ref, 0, sizeof(struct compare_ref_t));
+  struct capture_t cap;
+  struct replay_t* r = replay_open(path, &cap);
+  if(!r) {
+    return(EXIT_FAILURE);
+  }
+
+  ref->num_pins = cap.num_pins;
+  ref->samp_rate = cap.samp_rate;
+  memcpy(ref->pins, cap.pins, cap.num_pins * sizeof(int));
+
+  // the samples are only needed until the edges are indexed
+  int ret = EXIT_FAILURE;
+  uint32_t* samples = malloc((cap.num_samples ? cap.num_samples : 1) * sizeof(uint32_t));
+  long len = samples ? replay_read(r, samples, cap.num_samples) : -1;
+  if(len >= 0) {
+    ret = edges_build(&ref->edges, samples, len, (cap.num_pins < 32) ? ((1UL << cap.num_pins) - 1) : UINT32_MAX);
+  }
+  free(samples);
+  replay_close(r);
+  return(ret);
+}
+
+void compare_free(struct compare_ref_t* ref) {
+  edges_free(&ref->edges);
+}
+
+size_t compare_trigger(const struct edges_t* edges, unsigned int ch, enum trig_type_e type) {
+  if((type == TRIG_TYPE_IMMEDIATE) || (type == TRIG_TYPE_ANY) || (edges->num_samples == 0)) {
+    return(0);
+  }
+
+  // edges alternate, so if the first sample is not at the level after the trigger edge, the first edge is the trigger
+  int level = (type == TRIG_TYPE_RISING);
+  if((int)((edges->initial >> ch) & 1) == level) {
+    return(0);
+  }
+  return(edges->num[ch] ? edges->idx[ch][0] : edges->num_samples);
+}
+
+static size_t compare_add(struct compare_div_t* divs, size_t num, size_t max, enum compare_kind_e kind, long pos) {
+  if(num < max) {
+    divs[num].kind = kind;
+    divs[num].pos = pos;
+  }
+  return(num + 1);
+}
+
+size_t compare_channel(const struct edges_t* cap, unsigned int cap_ch, size_t cap_trig,
+  const struct edges_t* ref, unsigned int ref_ch, size_t ref_trig, size_t jitter, struct compare_div_t* divs, size_t max) {
+  // range covered by both, relative to the trigger
+  long lo = -(long)((cap_trig < ref_trig) ? cap_trig : ref_trig);
+  long cap_end = (long)cap->num_samples - (long)cap_trig;
+  long ref_end = (long)ref->num_samples - (long)ref_trig;
+  long hi = (cap_end < ref_end) ? cap_end : ref_end;
+  if(hi <= lo) {
+    return(0);
+  }
+
+  size_t cap_lo = lo + (long)cap_trig;
+  size_t ref_lo = lo + (long)ref_trig;
+  size_t num = 0;
+  if(edges_level(cap, cap_ch, cap_lo) != edges_level(ref, ref_ch, ref_lo)) {
+    num = compare_add(divs, num, max, COMPARE_KIND_LEVEL, lo);
+  }
+
+  // merge the two edge lists, edges at most jitter samples apart are the same edge
+  const size_t* a = cap->idx[cap_ch];
+  const size_t* b = ref->idx[ref_ch];
+  size_t i = edges_count(cap, cap_ch, 0, cap_lo);
+  size_t j = edges_count(ref, ref_ch, 0, ref_lo);
+  size_t i_end = i + edges_count(cap, cap_ch, cap_lo, hi + (long)cap_trig);
+  size_t j_end = j + edges_count(ref, ref_ch, ref_lo, hi + (long)ref_trig);
+  while((i < i_end) || (j < j_end)) {
+    long pa = (i < i_end) ? (long)a[i] - (long)cap_trig : 0;
+    long pb = (j < j_end) ? (long)b[j] - (long)ref_trig : 0;
+    enum compare_kind_e kind;
+    long pos;
+    if((i < i_end) && (j < j_end) && (labs(pa - pb) <= (long)jitter)) {
+      i++;
+      j++;
+      continue;
+    } else if((j == j_end) || ((i < i_end) && (pa < pb))) {
+      kind = COMPARE_KIND_EXTRA;
+      pos = pa;
+      i++;
+    } else {
+      kind = COMPARE_KIND_MISSING;
+      pos = pb;
+      j++;
+    }
+
+    // the matching edge may lie just outside of the range
+    if((pos >= lo + (long)jitter) && (pos < hi - (long)jitter)) {
+      num = compare_add(divs, num, max, kind, pos);
+    }
+  }
+  return(num);
+}
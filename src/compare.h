@@ -0,0 +1,50 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+#include "edges.h"
+#include "replay.h"
+#include "trigger.h"
+
+// golden reference capture, only its transitions are kept
+struct compare_ref_t {
+  unsigned int num_pins;
+  int pins[REPLAY_CHANNELS_MAX];
+  double samp_rate;
+  struct edges_t edges;
+};
+
+enum compare_kind_e {
+  // channel level differs at the start of the compared range
+  COMPARE_KIND_LEVEL = 0,
+
+  // edge in the reference with no edge in the capture within the jitter, and the other way around
+  COMPARE_KIND_MISSING,
+  COMPARE_KIND_EXTRA,
+};
+
+struct compare_div_t {
+  enum compare_kind_e kind;
+
+  // position relative to the trigger, in samples
+  long pos;
+};
+
+// load reference from a sigrok session file, returns EXIT_SUCCESS or EXIT_FAILURE
+int compare_load(const char* path, struct compare_ref_t* ref);
+
+void compare_free(struct compare_ref_t* ref);
+
+// sample at which a capture of channel ch triggered, a capture starting at the level after the trigger edge
+// (as all captures by this tool do) triggers at its first sample, returns num_samples if it never triggers
+size_t compare_trigger(const struct edges_t* edges, unsigned int ch, enum trig_type_e type);
+
+// compare edges of one channel in the range covered by both after aligning them on their triggers
+// returns the total number of divergences, the first max of them are stored in divs
+size_t compare_channel(const struct edges_t* cap, unsigned int cap_ch, size_t cap_trig,
+  const struct edges_t* ref, unsigned int ref_ch, size_t ref_trig, size_t jitter, struct compare_div_t* divs, size_t max);
+
+#endif
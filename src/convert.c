@@ -0,0 +1,42 @@
+#include "convert.h"
+
+void convert_samples(const uint32_t* raw, uint32_t* out, size_t num_samples, const int* pins, unsigned int num_pins) {
+  for(size_t i = 0; i < num_samples; i++) {
+    uint32_t sample = raw[i];
+    uint32_t val = 0;
+    for(unsigned int j = 0; j < num_pins; j++) {
+      val |= (((sample & (1UL << pins[j])) != 0) << j);
+    }
+    out[i] = val;
+  }
+}
+
+void convert_samples_wide(const uint32_t* raw, uint32_t* out, size_t num_samples, const int* pins, unsigned int num_pins) {
+  for(size_t i = 0; i < num_samples; i++) {
+    uint64_t sample = (uint64_t)raw[2*i] | ((uint64_t)raw[2*i + 1] << 32);
+    uint32_t val = 0;
+    for(unsigned int j = 0; j < num_pins; j++) {
+      val |= (((sample & (1ULL << pins[j])) != 0) << j);
+    }
+    out[i] = val;
+  }
+}
+
+void convert_pack(const uint32_t* samples, uint8_t* out, size_t num_samples, unsigned int unitsize) {
+  for(size_t i = 0; i < num_samples; i++) {
+    uint32_t val = samples[i];
+    for(unsigned int j = 0; j < unitsize; j++) {
+      *out++ = (val >> (8*j)) & 0xFF;
+    }
+  }
+}
+
+void convert_unpack(const uint8_t* in, uint32_t* samples, size_t num_samples, unsigned int unitsize) {
+  for(size_t i = 0; i < num_samples; i++) {
+    uint32_t val = 0;
+    for(unsigned int j = 0; j < unitsize; j++) {
+      val |= (uint32_t)*in++ << (8*j);
+    }
+    samples[i] = val;
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// gather the captured pins from raw GPIO level words into channel words (bit N = channel N)
+void convert_samples(const uint32_t* raw, uint32_t* out, size_t num_samples, const int* pins, unsigned int num_pins);
+
+// same as convert_samples, but every raw sample is a pair of GPLEV0 and GPLEV1 words, so pins can be 0 - 63
+void convert_samples_wide(const uint32_t* raw, uint32_t* out, size_t num_samples, const int* pins, unsigned int num_pins);
+
+// pack channel words into sigrok-style little-endian samples of unitsize bytes each
+void convert_pack(const uint32_t* samples, uint8_t* out, size_t num_samples, unsigned int unitsize);
+
+// reverse of convert_pack, unitsize must be at most 4
+void convert_unpack(const uint8_t* in, uint32_t* samples, size_t num_samples, unsigned int unitsize);
+
+#endif
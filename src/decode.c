@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "decode.h"
+
+static const struct decoder_t* decoders[] = {
+  &decoder_spi,
+  &decoder_i2c,
+  &decoder_uart,
+};
+
+const struct decoder_t* decode_find(const char* spec, const char** opts) {
+  const char* sep = strchr(spec, ':');
+  size_t len = sep ? (size_t)(sep - spec) : strlen(spec);
+  *opts = sep ? sep + 1 : "";
+  for(size_t i = 0; i < sizeof(decoders)/sizeof(decoders[0]); i++) {
+    if((strlen(decoders[i]->name) == len) && (strncmp(decoders[i]->name, spec, len) == 0)) {
+      return(decoders[i]);
+    }
+  }
+  return(NULL);
+}
+
+// pointer to the value of option key, or NULL if it is not present
+static const char* decode_opt_find(const char* opts, const char* key) {
+  size_t len = strlen(key);
+  const char* ptr = opts;
+  while(ptr && *ptr) {
+    if((strncmp(ptr, key, len) == 0) && (ptr[len] == '=')) {
+      return(&ptr[len + 1]);
+    }
+    ptr = strchr(ptr, ',');
+    if(ptr) { ptr++; }
+  }
+  return(NULL);
+}
+
+static int decode_pin_channel(const char* key, const char* val, const struct capture_t* cap) {
+  int pin = atoi(val);
+  for(unsigned int i = 0; i < cap->num_pins; i++) {
+    if(cap->pins[i] == pin) {
+      return(i);
+    }
+  }
+  fprintf(stderr, "Decoder pin %s=%d was not captured\n", key, pin);
+  return(-2);
+}
+
+int decode_opt_pin(const char* opts, const char* key, const struct capture_t* cap) {
+  const char* val = decode_opt_find(opts, key);
+  if(!val) {
+    return(-1);
+  }
+  return(decode_pin_channel(key, val, cap));
+}
+
+int decode_opt_pins(const char* opts, const char* key, const struct capture_t* cap, int* chs, int max) {
+  int num = 0;
+  const char* val = decode_opt_find(opts, key);
+  while(val && (num < max)) {
+    chs[num] = decode_pin_channel(key, val, cap);
+    if(chs[num] < 0) {
+      return(-1);
+    }
+    num++;
+
+    // continue after this option
+    val = strchr(val, ',');
+    val = val ? decode_opt_find(val + 1, key) : NULL;
+  }
+  return(num);
+}
+
+long decode_opt_int(const char* opts, const char* key, long def) {
+  const char* val = decode_opt_find(opts, key);
+  return(val ? strtol(val, NULL, 0) : def);
+}
+
+int decode_opt_is(const char* opts, const char* key, const char* val) {
+  const char* ptr = decode_opt_find(opts, key);
+  size_t len = strlen(val);
+  return(ptr && (strncmp(ptr, val, len) == 0) && ((ptr[len] == ',') || (ptr[len] == '\0')));
+}
+
+int decode_write_rec(const struct decode_out_t* out, const struct decode_rec_t* rec, const void* payload) {
+  if(fwrite(rec, sizeof(struct decode_rec_t), 1, out->fp) != 1) {
+    return(EXIT_FAILURE);
+  }
+  if(payload && rec->len && (fwrite(payload, rec->len, 1, out->fp) != 1)) {
+    return(EXIT_FAILURE);
+  }
+  return(EXIT_SUCCESS);
+}
+
+void decode_put_hex(FILE* fp, const uint8_t* data, size_t len) {
+  static const char digits[] = "0123456789ABCDEF";
+  for(size_t i = 0; i < len; i++) {
+    putc_unlocked(digits[data[i] >> 4], fp);
+    putc_unlocked(digits[data[i] & 0x0F], fp);
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+#include "edges.h"
+
+/*
+  Protocol decoders, run over the whole capture once it is finished.
+  Every decoder emits records, either as CSV lines "<decoder>,<kind>,<start>,<end>,<fields...>"
+  with start and end as sample indices, or as binary records in host byte order:
+
+  offset  size  field
+  0       1     protocol, see decode_proto_e
+  1       1     record kind, specific to the protocol
+  2       2     flags, specific to the protocol
+  4       4     length of the payload following the record
+  8       8     index of the first sample
+  16      8     index of the last sample
+*/
+
+enum decode_fmt_e {
+  DECODE_FMT_CSV = 0,
+  DECODE_FMT_BIN,
+};
+
+enum decode_proto_e {
+  DECODE_PROTO_SPI = 1,
+  DECODE_PROTO_I2C,
+  DECODE_PROTO_UART,
+};
+
+struct decode_rec_t {
+  uint8_t proto;
+  uint8_t kind;
+  uint16_t flags;
+  uint32_t len;
+  uint64_t start;
+  uint64_t end;
+};
+
+struct decode_out_t {
+  FILE* fp;
+  enum decode_fmt_e fmt;
+};
+
+struct decoder_t {
+  // decoder name as used on the command line
+  const char* name;
+
+  // parse comma-separated key=value options, channels are given by their BCM pin numbers
+  // returns decoder context or NULL if the options are invalid
+  void* (*init)(const char* opts, const struct capture_t* cap);
+
+  // decode num_samples channel words (bit N = channel N), edges are indexed for all channels
+  // returns EXIT_SUCCESS or EXIT_FAILURE
+  int (*run)(void* ctx, const uint32_t* samples, size_t num_samples, const struct edges_t* edges, const struct decode_out_t* out);
+
+  void (*free)(void* ctx);
+};
+
+extern const struct decoder_t decoder_spi;
+extern const struct decoder_t decoder_i2c;
+extern const struct decoder_t decoder_uart;
+
+// find decoder for spec "<name>:<options>", opts is set to the options part
+// returns NULL if there is no such decoder
+const struct decoder_t* decode_find(const char* spec, const char** opts);
+
+// channel of the pin given by option key, -1 if the option is not present, -2 if the pin was not captured
+int decode_opt_pin(const char* opts, const char* key, const struct capture_t* cap);
+
+// channels of all pins given by repeated option key, at most max of them
+// returns their number, or -1 if any of the pins was not captured
+int decode_opt_pins(const char* opts, const char* key, const struct capture_t* cap, int* chs, int max);
+
+// integer value of option key, or def if it is not present
+long decode_opt_int(const char* opts, const char* key, long def);
+
+// check whether option key has the value val
+int decode_opt_is(const char* opts, const char* key, const char* val);
+
+// write binary record with its payload, payload may be NULL if the decoder writes it on its own
+int decode_write_rec(const struct decode_out_t* out, const struct decode_rec_t* rec, const void* payload);
+
+// write bytes as hex into CSV field
+void decode_put_hex(FILE* fp, const uint8_t* data, size_t len);
+
+#endif
@@ -0,0 +1,266 @@
+/*
+  I2C decoder. The edge lists of SCL and SDA are merged into a single transition list,
+  each transition is classified by a table indexed by the old and new bus levels,
+  and fed to a table-driven state machine.
+
+  Options: scl, sda (BCM pins).
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "decode.h"
+
+enum i2c_kind_e {
+  I2C_KIND_START = 0,
+  I2C_KIND_RESTART,
+  I2C_KIND_ADDR,
+  I2C_KIND_WRITE,
+  I2C_KIND_READ,
+  I2C_KIND_STOP,
+};
+
+static const char* i2c_kind_names[] = { "start", "restart", "addr", "write", "read", "stop" };
+
+// byte was not acknowledged
+#define I2C_FLAG_NACK         (1 << 0)
+
+// address byte of a read transfer
+#define I2C_FLAG_READ         (1 << 1)
+
+// bus levels are 2-bit values, SCL << 1 | SDA
+#define I2C_SCL               (2)
+#define I2C_SDA               (1)
+
+enum i2c_event_e {
+  I2C_EV_NONE = 0,
+  I2C_EV_START,
+  I2C_EV_STOP,
+  I2C_EV_BIT0,
+  I2C_EV_BIT1,
+  I2C_NUM_EVENTS,
+};
+
+// event for each transition, indexed by old levels << 2 | new levels
+// SDA changing while SCL is high is START or STOP, SCL rising clocks in a bit
+// when both change at once, the clock edge wins
+static const uint8_t i2c_events[16] = {
+  [0x0 << 2 | 0x2] = I2C_EV_BIT0,
+  [0x0 << 2 | 0x3] = I2C_EV_BIT1,
+  [0x1 << 2 | 0x2] = I2C_EV_BIT0,
+  [0x1 << 2 | 0x3] = I2C_EV_BIT1,
+  [0x3 << 2 | 0x2] = I2C_EV_START,
+  [0x2 << 2 | 0x3] = I2C_EV_STOP,
+};
+
+enum i2c_state_e {
+  I2C_ST_IDLE = 0,
+  I2C_ST_ADDR,
+  I2C_ST_ADDR_ACK,
+  I2C_ST_DATA,
+  I2C_ST_DATA_ACK,
+  I2C_NUM_STATES,
+};
+
+enum i2c_action_e {
+  I2C_ACT_NONE = 0,
+  I2C_ACT_START,
+  I2C_ACT_STOP,
+  I2C_ACT_SHIFT,
+  I2C_ACT_ACK,
+};
+
+static const struct i2c_transition_t {
+  uint8_t next;
+  uint8_t action;
+} i2c_fsm[I2C_NUM_STATES][I2C_NUM_EVENTS] = {
+  [I2C_ST_IDLE] = {
+    [I2C_EV_NONE] = { I2C_ST_IDLE, I2C_ACT_NONE },
+    [I2C_EV_START] = { I2C_ST_ADDR, I2C_ACT_START },
+    [I2C_EV_STOP] = { I2C_ST_IDLE, I2C_ACT_NONE },
+    [I2C_EV_BIT0] = { I2C_ST_IDLE, I2C_ACT_NONE },
+    [I2C_EV_BIT1] = { I2C_ST_IDLE, I2C_ACT_NONE },
+  },
+  [I2C_ST_ADDR] = {
+    [I2C_EV_NONE] = { I2C_ST_ADDR, I2C_ACT_NONE },
+    [I2C_EV_START] = { I2C_ST_ADDR, I2C_ACT_START },
+    [I2C_EV_STOP] = { I2C_ST_IDLE, I2C_ACT_STOP },
+    [I2C_EV_BIT0] = { I2C_ST_ADDR, I2C_ACT_SHIFT },
+    [I2C_EV_BIT1] = { I2C_ST_ADDR, I2C_ACT_SHIFT },
+  },
+  [I2C_ST_ADDR_ACK] = {
+    [I2C_EV_NONE] = { I2C_ST_ADDR_ACK, I2C_ACT_NONE },
+    [I2C_EV_START] = { I2C_ST_ADDR, I2C_ACT_START },
+    [I2C_EV_STOP] = { I2C_ST_IDLE, I2C_ACT_STOP },
+    [I2C_EV_BIT0] = { I2C_ST_DATA, I2C_ACT_ACK },
+    [I2C_EV_BIT1] = { I2C_ST_DATA, I2C_ACT_ACK },
+  },
+  [I2C_ST_DATA] = {
+    [I2C_EV_NONE] = { I2C_ST_DATA, I2C_ACT_NONE },
+    [I2C_EV_START] = { I2C_ST_ADDR, I2C_ACT_START },
+    [I2C_EV_STOP] = { I2C_ST_IDLE, I2C_ACT_STOP },
+    [I2C_EV_BIT0] = { I2C_ST_DATA, I2C_ACT_SHIFT },
+    [I2C_EV_BIT1] = { I2C_ST_DATA, I2C_ACT_SHIFT },
+  },
+  [I2C_ST_DATA_ACK] = {
+    [I2C_EV_NONE] = { I2C_ST_DATA_ACK, I2C_ACT_NONE },
+    [I2C_EV_START] = { I2C_ST_ADDR, I2C_ACT_START },
+    [I2C_EV_STOP] = { I2C_ST_IDLE, I2C_ACT_STOP },
+    [I2C_EV_BIT0] = { I2C_ST_DATA, I2C_ACT_ACK },
+    [I2C_EV_BIT1] = { I2C_ST_DATA, I2C_ACT_ACK },
+  },
+};
+
+struct i2c_ctx_t {
+  int ch_scl;
+  int ch_sda;
+
+  // current byte, and whether the bus is in a transfer started by START
+  enum i2c_state_e state;
+  bool in_transfer;
+  bool read;
+  uint8_t byte;
+  unsigned int bits;
+  size_t byte_start;
+};
+
+static void* i2c_init(const char* opts, const struct capture_t* cap) {
+  struct i2c_ctx_t* ctx = calloc(1, sizeof(struct i2c_ctx_t));
+  if(!ctx) {
+    return(NULL);
+  }
+
+  ctx->ch_scl = decode_opt_pin(opts, "scl", cap);
+  ctx->ch_sda = decode_opt_pin(opts, "sda", cap);
+  if((ctx->ch_scl < 0) || (ctx->ch_sda < 0)) {
+    fprintf(stderr, "I2C decoder needs scl and sda\n");
+    free(ctx);
+    return(NULL);
+  }
+  return(ctx);
+}
+
+static void i2c_free(void* ctx) {
+  free(ctx);
+}
+
+static int i2c_emit(struct i2c_ctx_t* ctx, enum i2c_kind_e kind, uint16_t flags, size_t start, size_t end, const struct decode_out_t* out) {
+  if(out->fmt == DECODE_FMT_CSV) {
+    fprintf(out->fp, "i2c,%s,%lu,%lu", i2c_kind_names[kind], start, end);
+    if(kind == I2C_KIND_ADDR) {
+      fprintf(out->fp, ",%02X,%c,%s", ctx->byte >> 1, (flags & I2C_FLAG_READ) ? 'r' : 'w', (flags & I2C_FLAG_NACK) ? "nack" : "ack");
+    } else if((kind == I2C_KIND_WRITE) || (kind == I2C_KIND_READ)) {
+      fprintf(out->fp, ",%02X,%s", ctx->byte, (flags & I2C_FLAG_NACK) ? "nack" : "ack");
+    }
+    putc_unlocked('\n', out->fp);
+    return(ferror(out->fp) ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+
+  // address records carry the 7-bit address, data records the byte
+  uint8_t payload = (kind == I2C_KIND_ADDR) ? (ctx->byte >> 1) : ctx->byte;
+  bool has_payload = (kind == I2C_KIND_ADDR) || (kind == I2C_KIND_WRITE) || (kind == I2C_KIND_READ);
+  struct decode_rec_t rec = {
+    .proto = DECODE_PROTO_I2C, .kind = kind, .flags = flags,
+    .len = has_payload ? 1 : 0, .start = start, .end = end,
+  };
+  return(decode_write_rec(out, &rec, &payload));
+}
+
+static int i2c_step(struct i2c_ctx_t* ctx, enum i2c_event_e ev, size_t idx, const struct decode_out_t* out) {
+  const struct i2c_transition_t* tr = &i2c_fsm[ctx->state][ev];
+  enum i2c_state_e next = tr->next;
+  int ret = EXIT_SUCCESS;
+
+  switch(tr->action) {
+    case I2C_ACT_START:
+      ret = i2c_emit(ctx, ctx->in_transfer ? I2C_KIND_RESTART : I2C_KIND_START, 0, idx, idx, out);
+      ctx->in_transfer = true;
+      ctx->bits = 0;
+      ctx->byte = 0;
+      break;
+
+    case I2C_ACT_STOP:
+      ret = i2c_emit(ctx, I2C_KIND_STOP, 0, idx, idx, out);
+      ctx->in_transfer = false;
+      break;
+
+    case I2C_ACT_SHIFT:
+      if(ctx->bits == 0) {
+        ctx->byte_start = idx;
+        ctx->byte = 0;
+      }
+      ctx->byte = (ctx->byte << 1) | (ev == I2C_EV_BIT1);
+      if(++ctx->bits == 8) {
+        next = (ctx->state == I2C_ST_ADDR) ? I2C_ST_ADDR_ACK : I2C_ST_DATA_ACK;
+      }
+      break;
+
+    case I2C_ACT_ACK: {
+      // the ninth bit is low for ACK
+      uint16_t flags = (ev == I2C_EV_BIT1) ? I2C_FLAG_NACK : 0;
+      enum i2c_kind_e kind;
+      if(ctx->state == I2C_ST_ADDR_ACK) {
+        ctx->read = ctx->byte & 1;
+        kind = I2C_KIND_ADDR;
+        flags |= ctx->read ? I2C_FLAG_READ : 0;
+      } else {
+        kind = ctx->read ? I2C_KIND_READ : I2C_KIND_WRITE;
+      }
+      ret = i2c_emit(ctx, kind, flags, ctx->byte_start, idx, out);
+      ctx->bits = 0;
+    } break;
+
+    default:
+      break;
+  }
+
+  ctx->state = next;
+  return(ret);
+}
+
+static inline uint8_t i2c_levels(const struct i2c_ctx_t* ctx, uint32_t sample) {
+  return((((sample >> ctx->ch_scl) & 1) << 1) | ((sample >> ctx->ch_sda) & 1));
+}
+
+static int i2c_run(void* ptr, const uint32_t* samples, size_t num_samples, const struct edges_t* edges, const struct decode_out_t* out) {
+  struct i2c_ctx_t* ctx = (struct i2c_ctx_t*)ptr;
+  ctx->state = I2C_ST_IDLE;
+  ctx->in_transfer = false;
+  ctx->bits = 0;
+  if(num_samples == 0) {
+    return(EXIT_SUCCESS);
+  }
+
+  // merge the two sorted edge lists, changes of both lines in the same sample are a single transition
+  const size_t* scl = edges->idx[ctx->ch_scl];
+  const size_t* sda = edges->idx[ctx->ch_sda];
+  size_t num_scl = edges->num[ctx->ch_scl];
+  size_t num_sda = edges->num[ctx->ch_sda];
+  size_t a = 0, b = 0;
+  uint8_t levels = i2c_levels(ctx, samples[0]);
+  while((a < num_scl) || (b < num_sda)) {
+    size_t next_scl = (a < num_scl) ? scl[a] : SIZE_MAX;
+    size_t next_sda = (b < num_sda) ? sda[b] : SIZE_MAX;
+    size_t idx = (next_scl < next_sda) ? next_scl : next_sda;
+    a += (next_scl == idx);
+    b += (next_sda == idx);
+
+    uint8_t curr = i2c_levels(ctx, samples[idx]);
+    enum i2c_event_e ev = (enum i2c_event_e)i2c_events[(levels << 2) | curr];
+    levels = curr;
+    if((ev != I2C_EV_NONE) && (i2c_step(ctx, ev, idx, out) != EXIT_SUCCESS)) {
+      return(EXIT_FAILURE);
+    }
+  }
+
+  return(EXIT_SUCCESS);
+}
+
+const struct decoder_t decoder_i2c = {
+  .name = "i2c",
+  .init = i2c_init,
+  .run = i2c_run,
+  .free = i2c_free,
+};
@@ -0,0 +1,267 @@
+/*
+  SPI decoder. Clock and chip select are extracted into 64-sample bit planes,
+  so that edges of a whole block are found with a single XOR and shift,
+  and only the sampling clock edges and chip select changes are visited one by one.
+
+  Options: clk, mosi, miso, cs (BCM pins, mosi or miso may be omitted, without cs every byte is a transaction),
+  mode (0 - 3, CPOL*2 + CPHA), cspol (chip select active level, defaults to 0), order (msb or lsb).
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "decode.h"
+
+// samples in a single bit plane
+#define SPI_BLOCK             (64)
+
+#define SPI_KIND_XFER         (0)
+
+// the last byte of the transaction was not complete
+#define SPI_FLAG_PARTIAL      (1 << 0)
+
+// chip select was already active at the start or still active at the end of the capture
+#define SPI_FLAG_TRUNCATED    (1 << 1)
+
+struct spi_ctx_t {
+  int ch_clk;
+  int ch_mosi;
+  int ch_miso;
+  int ch_cs;
+  bool sample_rising;
+  bool cs_active_high;
+  bool lsb_first;
+
+  // current transaction
+  bool active;
+  size_t start;
+  uint16_t flags;
+  uint8_t* mosi;
+  uint8_t* miso;
+  size_t len;
+  size_t cap;
+  unsigned int bits;
+  uint8_t mosi_curr;
+  uint8_t miso_curr;
+};
+
+static void* spi_init(const char* opts, const struct capture_t* cap) {
+  struct spi_ctx_t* ctx = calloc(1, sizeof(struct spi_ctx_t));
+  if(!ctx) {
+    return(NULL);
+  }
+
+  ctx->ch_clk = decode_opt_pin(opts, "clk", cap);
+  ctx->ch_mosi = decode_opt_pin(opts, "mosi", cap);
+  ctx->ch_miso = decode_opt_pin(opts, "miso", cap);
+  ctx->ch_cs = decode_opt_pin(opts, "cs", cap);
+  long mode = decode_opt_int(opts, "mode", 0);
+  if((ctx->ch_clk < 0) || (ctx->ch_mosi < -1) || (ctx->ch_miso < -1) || (ctx->ch_cs < -1) ||
+     ((ctx->ch_mosi < 0) && (ctx->ch_miso < 0)) || (mode < 0) || (mode > 3)) {
+    fprintf(stderr, "SPI decoder needs clk and at least one of mosi and miso, mode must be 0 - 3\n");
+    free(ctx);
+    return(NULL);
+  }
+
+  // modes 0 and 3 sample on the rising edge, modes 1 and 2 on the falling edge
+  ctx->sample_rising = ((mode == 0) || (mode == 3));
+  ctx->cs_active_high = (decode_opt_int(opts, "cspol", 0) != 0);
+  ctx->lsb_first = decode_opt_is(opts, "order", "lsb");
+  return(ctx);
+}
+
+static void spi_free(void* ptr) {
+  struct spi_ctx_t* ctx = (struct spi_ctx_t*)ptr;
+  free(ctx->mosi);
+  free(ctx->miso);
+  free(ctx);
+}
+
+static void spi_begin(struct spi_ctx_t* ctx, size_t idx) {
+  ctx->active = true;
+  ctx->start = idx;
+  ctx->flags = 0;
+  ctx->len = 0;
+  ctx->bits = 0;
+  ctx->mosi_curr = 0;
+  ctx->miso_curr = 0;
+}
+
+static int spi_emit(struct spi_ctx_t* ctx, size_t end, const struct decode_out_t* out) {
+  ctx->active = false;
+  if(ctx->bits) {
+    ctx->flags |= SPI_FLAG_PARTIAL;
+  }
+
+  if(out->fmt == DECODE_FMT_CSV) {
+    fprintf(out->fp, "spi,xfer,%lu,%lu,", ctx->start, end);
+    if(ctx->ch_mosi >= 0) { decode_put_hex(out->fp, ctx->mosi, ctx->len); }
+    putc_unlocked(',', out->fp);
+    if(ctx->ch_miso >= 0) { decode_put_hex(out->fp, ctx->miso, ctx->len); }
+    fprintf(out->fp, ",%u\n", ctx->flags);
+    return(ferror(out->fp) ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+
+  // payload is MOSI bytes followed by MISO bytes
+  struct decode_rec_t rec = {
+    .proto = DECODE_PROTO_SPI, .kind = SPI_KIND_XFER, .flags = ctx->flags,
+    .len = 2*ctx->len, .start = ctx->start, .end = end,
+  };
+  if((decode_write_rec(out, &rec, NULL) != EXIT_SUCCESS) ||
+     (ctx->len && ((fwrite(ctx->mosi, ctx->len, 1, out->fp) != 1) || (fwrite(ctx->miso, ctx->len, 1, out->fp) != 1)))) {
+    return(EXIT_FAILURE);
+  }
+  return(EXIT_SUCCESS);
+}
+
+static int spi_push_byte(struct spi_ctx_t* ctx) {
+  if(ctx->len == ctx->cap) {
+    size_t cap = ctx->cap ? 2*ctx->cap : 256;
+    uint8_t* mosi = realloc(ctx->mosi, cap);
+    if(mosi) { ctx->mosi = mosi; }
+    uint8_t* miso = realloc(ctx->miso, cap);
+    if(miso) { ctx->miso = miso; }
+    if(!mosi || !miso) {
+      fprintf(stderr, "Failed to allocate SPI transaction of %lu bytes\n", cap);
+      return(EXIT_FAILURE);
+    }
+    ctx->cap = cap;
+  }
+
+  ctx->mosi[ctx->len] = ctx->mosi_curr;
+  ctx->miso[ctx->len] = ctx->miso_curr;
+  ctx->len++;
+  ctx->bits = 0;
+  ctx->mosi_curr = 0;
+  ctx->miso_curr = 0;
+  return(EXIT_SUCCESS);
+}
+
+static int spi_sample(struct spi_ctx_t* ctx, uint32_t sample, size_t idx, const struct decode_out_t* out) {
+  if(ctx->ch_cs < 0) {
+    if(ctx->bits == 0) {
+      spi_begin(ctx, idx);
+    }
+  } else if(!ctx->active) {
+    return(EXIT_SUCCESS);
+  }
+
+  unsigned int mosi = (ctx->ch_mosi >= 0) ? (sample >> ctx->ch_mosi) & 1 : 0;
+  unsigned int miso = (ctx->ch_miso >= 0) ? (sample >> ctx->ch_miso) & 1 : 0;
+  if(ctx->lsb_first) {
+    ctx->mosi_curr |= mosi << ctx->bits;
+    ctx->miso_curr |= miso << ctx->bits;
+  } else {
+    ctx->mosi_curr = (ctx->mosi_curr << 1) | mosi;
+    ctx->miso_curr = (ctx->miso_curr << 1) | miso;
+  }
+
+  if(++ctx->bits < 8) {
+    return(EXIT_SUCCESS);
+  }
+  if(spi_push_byte(ctx) != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+
+  // without chip select, every byte is a transaction of its own
+  if(ctx->ch_cs < 0) {
+    return(spi_emit(ctx, idx, out));
+  }
+  return(EXIT_SUCCESS);
+}
+
+// bit j of the planes is the level of clock and chip select in sample j of the block
+static void spi_planes(const uint32_t* samples, size_t len, int ch_clk, int ch_cs, uint64_t* clk, uint64_t* cs) {
+  uint64_t clk_plane = 0;
+  uint64_t cs_plane = 0;
+  for(size_t j = 0; j < len; j++) {
+    clk_plane |= (uint64_t)((samples[j] >> ch_clk) & 1) << j;
+    cs_plane |= (uint64_t)((samples[j] >> ch_cs) & 1) << j;
+  }
+  *clk = clk_plane;
+  *cs = cs_plane;
+}
+
+// the dense clock is cheaper to scan in bit planes than through the edge index
+static int spi_run(void* ptr, const uint32_t* samples, size_t num_samples, const struct edges_t* edges, const struct decode_out_t* out) {
+  (void)edges;
+  struct spi_ctx_t* ctx = (struct spi_ctx_t*)ptr;
+  ctx->active = false;
+  ctx->bits = 0;
+  ctx->mosi_curr = 0;
+  ctx->miso_curr = 0;
+  if(num_samples == 0) {
+    return(EXIT_SUCCESS);
+  }
+
+  // the previous levels start the same as the first sample, so that it is not an edge
+  uint64_t clk_prev = (samples[0] >> ctx->ch_clk) & 1;
+  uint64_t cs_prev = 0;
+  uint64_t cs_invert = ctx->cs_active_high ? 0 : UINT64_MAX;
+  if(ctx->ch_cs >= 0) {
+    cs_prev = ((samples[0] >> ctx->ch_cs) & 1) ^ (cs_invert & 1);
+    if(cs_prev) {
+      spi_begin(ctx, 0);
+      ctx->flags |= SPI_FLAG_TRUNCATED;
+    }
+  }
+
+  for(size_t b = 0; b < num_samples; b += SPI_BLOCK) {
+    size_t len = (num_samples - b < SPI_BLOCK) ? num_samples - b : SPI_BLOCK;
+    uint64_t valid = (len == SPI_BLOCK) ? UINT64_MAX : ((1ULL << len) - 1);
+
+    // a set bit in edges means the level differs from the previous sample
+    uint64_t clk, cs;
+    spi_planes(&samples[b], len, ctx->ch_clk, (ctx->ch_cs >= 0) ? ctx->ch_cs : ctx->ch_clk, &clk, &cs);
+    uint64_t clk_edges = (clk ^ ((clk << 1) | clk_prev)) & valid;
+    uint64_t events = clk_edges & (ctx->sample_rising ? clk : ~clk);
+    clk_prev = (clk >> (len - 1)) & 1;
+
+    // chip select is stored as active level, so that 1 means selected
+    uint64_t cs_edges = 0;
+    if(ctx->ch_cs >= 0) {
+      cs = (cs ^ cs_invert) & valid;
+      cs_edges = (cs ^ ((cs << 1) | cs_prev)) & valid;
+      cs_prev = (cs >> (len - 1)) & 1;
+    }
+
+    events |= cs_edges;
+    while(events) {
+      unsigned int j = __builtin_ctzll(events);
+      events &= events - 1;
+      size_t idx = b + j;
+
+      // a clock edge at the same time as deselect still belongs to the transaction
+      if((clk_edges >> j) & 1) {
+        bool sampling = (((clk >> j) & 1) != 0) == ctx->sample_rising;
+        if(sampling && (spi_sample(ctx, samples[idx], idx, out) != EXIT_SUCCESS)) {
+          return(EXIT_FAILURE);
+        }
+      }
+
+      if((cs_edges >> j) & 1) {
+        if((cs >> j) & 1) {
+          spi_begin(ctx, idx);
+        } else if(ctx->active && (spi_emit(ctx, idx, out) != EXIT_SUCCESS)) {
+          return(EXIT_FAILURE);
+        }
+      }
+    }
+  }
+
+  if((ctx->ch_cs >= 0) && ctx->active) {
+    ctx->flags |= SPI_FLAG_TRUNCATED;
+    return(spi_emit(ctx, num_samples - 1, out));
+  }
+  return(EXIT_SUCCESS);
+}
+
+const struct decoder_t decoder_spi = {
+  .name = "spi",
+  .init = spi_init,
+  .run = spi_run,
+  .free = spi_free,
+};
@@ -0,0 +1,327 @@
+/*
+  UART decoder. Every line is decoded by its own thread: the bit period is estimated from
+  the shortest stable pulses in the edge list of the line, and each frame is then sampled
+  in the middle of its bits.
+  Records of each line are buffered and written in the order the lines were given.
+
+  Options: rx (BCM pin, can be repeated for more lines), baud (defaults to automatic detection),
+  bits (5 - 8, defaults to 8), parity (none, even or odd, defaults to none).
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "decode.h"
+
+#define UART_LINES_MAX          (32)
+
+// number of pulses of similar length needed to accept the shortest one as the bit period
+#define UART_BAUD_MIN_PULSES    (3)
+
+// pulses up to this much longer than the shortest one are considered the same length
+#define UART_BAUD_TOLERANCE     (1.25)
+
+// pulses longer than this many bits are idle periods, and are not used to refine the bit period
+#define UART_BAUD_MAX_BITS      (12)
+
+enum uart_kind_e {
+  UART_KIND_BAUD = 0,
+  UART_KIND_DATA,
+  UART_KIND_BREAK,
+};
+
+static const char* uart_kind_names[] = { "baud", "data", "break" };
+
+// stop bit was low
+#define UART_FLAG_FRAMING       (1 << 0)
+
+// parity bit did not match
+#define UART_FLAG_PARITY        (1 << 1)
+
+enum uart_parity_e {
+  UART_PARITY_NONE = 0,
+  UART_PARITY_EVEN,
+  UART_PARITY_ODD,
+};
+
+struct uart_ctx_t {
+  int chs[UART_LINES_MAX];
+  int num_lines;
+  const int* pins;
+  double samp_rate;
+  double baud;
+  unsigned int bits;
+  enum uart_parity_e parity;
+};
+
+// state of a single line, owned by its thread
+struct uart_line_t {
+  const struct uart_ctx_t* ctx;
+  int ch;
+  int pin;
+  const uint32_t* samples;
+  size_t num_samples;
+  const size_t* trans;
+  size_t num_trans;
+  double period;
+
+  // records are buffered in memory until all threads finish
+  struct decode_out_t out;
+  char* buff;
+  size_t len;
+  int ret;
+};
+
+static void* uart_init(const char* opts, const struct capture_t* cap) {
+  struct uart_ctx_t* ctx = calloc(1, sizeof(struct uart_ctx_t));
+  if(!ctx) {
+    return(NULL);
+  }
+
+  ctx->num_lines = decode_opt_pins(opts, "rx", cap, ctx->chs, UART_LINES_MAX);
+  ctx->pins = cap->pins;
+  ctx->samp_rate = cap->samp_rate;
+  ctx->baud = (double)decode_opt_int(opts, "baud", 0);
+  ctx->bits = decode_opt_int(opts, "bits", 8);
+  ctx->parity = UART_PARITY_NONE;
+  if(decode_opt_is(opts, "parity", "even")) {
+    ctx->parity = UART_PARITY_EVEN;
+  } else if(decode_opt_is(opts, "parity", "odd")) {
+    ctx->parity = UART_PARITY_ODD;
+  }
+
+  if((ctx->num_lines < 1) || (ctx->bits < 5) || (ctx->bits > 8) || (ctx->baud < 0) || (ctx->baud > ctx->samp_rate / 2)) {
+    fprintf(stderr, "UART decoder needs at least one rx pin, 5 - 8 bits and baud rate below half of the sample rate\n");
+    free(ctx);
+    return(NULL);
+  }
+  return(ctx);
+}
+
+static void uart_free(void* ctx) {
+  free(ctx);
+}
+
+static int uart_emit(struct uart_line_t* line, enum uart_kind_e kind, uint16_t flags, size_t start, size_t end, uint32_t val) {
+  const struct decode_out_t* out = &line->out;
+  if(out->fmt == DECODE_FMT_CSV) {
+    if(kind == UART_KIND_BAUD) {
+      fprintf(out->fp, "uart,%s,%lu,%lu,%d,%u\n", uart_kind_names[kind], start, end, line->pin, val);
+    } else {
+      fprintf(out->fp, "uart,%s,%lu,%lu,%d,%02X,%u\n", uart_kind_names[kind], start, end, line->pin, val, flags);
+    }
+    return(ferror(out->fp) ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+
+  // payload is the pin number followed by the data byte, or by the baud rate as 32-bit value
+  uint8_t payload[8] = { (uint8_t)line->pin };
+  uint32_t len = 2;
+  if(kind == UART_KIND_BAUD) {
+    memcpy(&payload[4], &val, sizeof(val));
+    len = 8;
+  } else {
+    payload[1] = (uint8_t)val;
+  }
+  struct decode_rec_t rec = {
+    .proto = DECODE_PROTO_UART, .kind = kind, .flags = flags,
+    .len = len, .start = start, .end = end,
+  };
+  return(decode_write_rec(out, &rec, payload));
+}
+
+static int uart_cmp_size(const void* a, const void* b) {
+  size_t x = *(const size_t*)a;
+  size_t y = *(const size_t*)b;
+  return((x > y) - (x < y));
+}
+
+// bit period in samples estimated from pulse lengths, 0 if there are not enough pulses
+static double uart_detect_period(const struct uart_line_t* line) {
+  // the first and last level are cut by the capture, only complete pulses count
+  if(line->num_trans < UART_BAUD_MIN_PULSES + 1) {
+    return(0);
+  }
+  size_t num = line->num_trans - 1;
+  size_t* pulses = malloc(num * sizeof(size_t));
+  if(!pulses) {
+    return(0);
+  }
+  for(size_t i = 0; i < num; i++) {
+    pulses[i] = line->trans[i + 1] - line->trans[i];
+  }
+  qsort(pulses, num, sizeof(size_t), uart_cmp_size);
+
+  // shortest pulse that is not a glitch, there must be a few more of about the same length
+  double shortest = 0;
+  for(size_t i = 0; i + UART_BAUD_MIN_PULSES - 1 < num; i++) {
+    if((double)pulses[i + UART_BAUD_MIN_PULSES - 1] <= (double)pulses[i] * UART_BAUD_TOLERANCE) {
+      shortest = (double)pulses[i];
+      break;
+    }
+  }
+
+  // refine by fitting whole numbers of bits to all pulses within a frame
+  double period = 0;
+  if(shortest > 0) {
+    double samples = 0, bits = 0;
+    for(size_t i = 0; i < num; i++) {
+      double n = round((double)pulses[i] / shortest);
+      if((n >= 1) && (n <= UART_BAUD_MAX_BITS)) {
+        samples += (double)pulses[i];
+        bits += n;
+      }
+    }
+    period = samples / bits;
+  }
+
+  free(pulses);
+  return(period);
+}
+
+static inline unsigned int uart_level(const struct uart_line_t* line, double pos) {
+  return((line->samples[(size_t)pos] >> line->ch) & 1);
+}
+
+static int uart_decode_line(struct uart_line_t* line) {
+  const struct uart_ctx_t* ctx = line->ctx;
+  unsigned int frame_bits = 1 + ctx->bits + (ctx->parity != UART_PARITY_NONE) + 1;
+  size_t t = 0;
+  while(t < line->num_trans) {
+    // frames begin with the line falling to the start bit
+    size_t start = line->trans[t];
+    if(uart_level(line, (double)start) != 0) {
+      t++;
+      continue;
+    }
+
+    // the whole frame has to be in the capture
+    double stop_pos = (double)start + line->period * ((double)frame_bits - 0.5);
+    if(stop_pos >= (double)line->num_samples) {
+      break;
+    }
+
+    // start bit too short is a glitch
+    if(uart_level(line, (double)start + line->period * 0.5) != 0) {
+      t++;
+      continue;
+    }
+
+    unsigned int val = 0;
+    unsigned int ones = 0;
+    for(unsigned int k = 0; k < ctx->bits; k++) {
+      unsigned int bit = uart_level(line, (double)start + line->period * ((double)k + 1.5));
+      val |= bit << k;
+      ones += bit;
+    }
+
+    uint16_t flags = 0;
+    unsigned int parity = 0;
+    if(ctx->parity != UART_PARITY_NONE) {
+      parity = uart_level(line, (double)start + line->period * ((double)ctx->bits + 1.5));
+      if(((ones + parity) & 1) != (ctx->parity == UART_PARITY_ODD)) {
+        flags |= UART_FLAG_PARITY;
+      }
+    }
+    unsigned int stop = uart_level(line, stop_pos);
+    if(!stop) {
+      flags |= UART_FLAG_FRAMING;
+    }
+
+    // skip the rest of the frame
+    size_t end = (size_t)stop_pos;
+    while((t < line->num_trans) && (line->trans[t] <= end)) { t++; }
+
+    // line held low for the whole frame is a break, which lasts until the line goes high again
+    int ret;
+    if(!stop && (val == 0) && (parity == 0)) {
+      while((t < line->num_trans) && (uart_level(line, (double)line->trans[t]) == 0)) { t++; }
+      end = (t < line->num_trans) ? line->trans[t] : line->num_samples - 1;
+      ret = uart_emit(line, UART_KIND_BREAK, 0, start, end, 0);
+    } else {
+      ret = uart_emit(line, UART_KIND_DATA, flags, start, end, val);
+    }
+    if(ret != EXIT_SUCCESS) {
+      return(EXIT_FAILURE);
+    }
+  }
+
+  return(EXIT_SUCCESS);
+}
+
+static void* uart_thread(void* arg) {
+  struct uart_line_t* line = (struct uart_line_t*)arg;
+  line->ret = EXIT_FAILURE;
+  line->period = line->ctx->baud ? line->ctx->samp_rate / line->ctx->baud : uart_detect_period(line);
+  if(line->period <= 0) {
+    fprintf(stderr, "Not enough activity on UART pin %d to detect the baud rate\n", line->pin);
+    line->ret = EXIT_SUCCESS;
+    return(NULL);
+  }
+
+  if(uart_emit(line, UART_KIND_BAUD, 0, 0, line->num_samples - 1, (uint32_t)lround(line->ctx->samp_rate / line->period)) == EXIT_SUCCESS) {
+    line->ret = uart_decode_line(line);
+  }
+  return(NULL);
+}
+
+static int uart_run(void* ptr, const uint32_t* samples, size_t num_samples, const struct edges_t* edges, const struct decode_out_t* out) {
+  struct uart_ctx_t* ctx = (struct uart_ctx_t*)ptr;
+  struct uart_line_t lines[UART_LINES_MAX];
+  pthread_t threads[UART_LINES_MAX];
+  bool started[UART_LINES_MAX] = { false };
+  if(num_samples < 2) {
+    return(EXIT_SUCCESS);
+  }
+
+  for(int i = 0; i < ctx->num_lines; i++) {
+    struct uart_line_t* line = &lines[i];
+    memset(line, 0, sizeof(struct uart_line_t));
+    line->ctx = ctx;
+    line->ch = ctx->chs[i];
+    line->pin = ctx->pins[ctx->chs[i]];
+    line->samples = samples;
+    line->num_samples = num_samples;
+    line->trans = edges->idx[line->ch];
+    line->num_trans = edges->num[line->ch];
+    line->out.fmt = out->fmt;
+    line->out.fp = open_memstream(&line->buff, &line->len);
+    line->ret = EXIT_FAILURE;
+    if(line->out.fp) {
+      started[i] = (pthread_create(&threads[i], NULL, uart_thread, line) == 0);
+    }
+  }
+
+  int ret = EXIT_SUCCESS;
+  for(int i = 0; i < ctx->num_lines; i++) {
+    struct uart_line_t* line = &lines[i];
+    if(started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      fprintf(stderr, "Failed to start UART decoder for pin %d\n", line->pin);
+    }
+    if(line->out.fp) {
+      fclose(line->out.fp);
+      if(line->len && (fwrite(line->buff, line->len, 1, out->fp) != 1)) {
+        line->ret = EXIT_FAILURE;
+      }
+      free(line->buff);
+    }
+    if(line->ret != EXIT_SUCCESS) {
+      ret = EXIT_FAILURE;
+    }
+  }
+
+  return(ret);
+}
+
+const struct decoder_t decoder_uart = {
+  .name = "uart",
+  .init = uart_init,
+  .run = uart_run,
+  .free = uart_free,
+};
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "edges.h"
+
+// samples checked for changes at once, blocks without any change are skipped as a whole
+#define EDGES_BLOCK           (16)
+
+// OR of changes between consecutive samples in block starting at i, i must be at least 1
+// the loop has a fixed length and no branches, so that it is vectorized
+static inline uint32_t edges_block_changes(const uint32_t* samples, size_t i, uint32_t mask) {
+  uint32_t changes = 0;
+  for(size_t j = 0; j < EDGES_BLOCK; j++) {
+    changes |= samples[i + j] ^ samples[i + j - 1];
+  }
+  return(changes & mask);
+}
+
+// run body for every channel ch changing in sample i
+#define EDGES_FOR_CHANGES(samples, i, mask, ch, body) do { \
+  uint32_t diff = ((samples)[i] ^ (samples)[(i) - 1]) & (mask); \
+  while(diff) { \
+    unsigned int ch = __builtin_ctz(diff); \
+    diff &= diff - 1; \
+    body; \
+  } \
+} while(0)
+
+// visit every change, first to count and then to fill the lists
+static void edges_scan(struct edges_t* edges, const uint32_t* samples, uint32_t mask, bool fill) {
+  size_t num_samples = edges->num_samples;
+  size_t i = 1;
+  for(; i + EDGES_BLOCK <= num_samples; i += EDGES_BLOCK) {
+    if(!edges_block_changes(samples, i, mask)) {
+      continue;
+    }
+    for(size_t j = i; j < i + EDGES_BLOCK; j++) {
+      EDGES_FOR_CHANGES(samples, j, mask, ch, {
+        if(fill) { edges->idx[ch][edges->num[ch]] = j; }
+        edges->num[ch]++;
+      });
+    }
+  }
+
+  for(; i < num_samples; i++) {
+    EDGES_FOR_CHANGES(samples, i, mask, ch, {
+      if(fill) { edges->idx[ch][edges->num[ch]] = i; }
+      edges->num[ch]++;
+    });
+  }
+}
+
+int edges_build(struct edges_t* edges, const uint32_t* samples, size_t num_samples, uint32_t mask) {
+  memset(edges, 0, sizeof(struct edges_t));
+  edges->num_samples = num_samples;
+  if(num_samples == 0) {
+    return(EXIT_SUCCESS);
+  }
+  edges->initial = samples[0];
+
+  // count first, so that every list is allocated exactly once
+  edges_scan(edges, samples, mask, false);
+  for(unsigned int ch = 0; ch < EDGES_CHANNELS_MAX; ch++) {
+    if(!(mask & (1UL << ch))) {
+      continue;
+    }
+
+    // one extra entry, so that even channels without edges have a list
+    edges->idx[ch] = malloc((edges->num[ch] + 1) * sizeof(size_t));
+    if(!edges->idx[ch]) {
+      fprintf(stderr, "Failed to allocate %lu edges\n", edges->num[ch]);
+      edges_free(edges);
+      return(EXIT_FAILURE);
+    }
+    edges->num[ch] = 0;
+  }
+  edges_scan(edges, samples, mask, true);
+  return(EXIT_SUCCESS);
+}
+
+void edges_free(struct edges_t* edges) {
+  for(unsigned int ch = 0; ch < EDGES_CHANNELS_MAX; ch++) {
+    free(edges->idx[ch]);
+    edges->idx[ch] = NULL;
+    edges->num[ch] = 0;
+  }
+}
+
+// number of edges at or before sample i
+static size_t edges_upto(const struct edges_t* edges, unsigned int ch, size_t i) {
+  const size_t* idx = edges->idx[ch];
+  size_t lo = 0, hi = edges->num[ch];
+  while(lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if(idx[mid] <= i) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return(lo);
+}
+
+size_t edges_next(const struct edges_t* edges, unsigned int ch, size_t i) {
+  size_t n = edges_upto(edges, ch, i);
+  return((n < edges->num[ch]) ? edges->idx[ch][n] : edges->num_samples);
+}
+
+size_t edges_count(const struct edges_t* edges, unsigned int ch, size_t from, size_t to) {
+  if((to <= from) || (to == 0)) {
+    return(0);
+  }
+  size_t before = from ? edges_upto(edges, ch, from - 1) : 0;
+  return(edges_upto(edges, ch, to - 1) - before);
+}
+
+int edges_level(const struct edges_t* edges, unsigned int ch, size_t i) {
+  return((int)(((edges->initial >> ch) ^ edges_upto(edges, ch, i)) & 1));
+}
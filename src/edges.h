@@ -0,0 +1,38 @@
+#ifndef EDGES_H
+#define EDGES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+
+// maximum number of channels, one bit of the sample word each
+#define EDGES_CHANNELS_MAX    (32)
+
+// sorted sample indices of the level changes of every channel, built once after the capture
+struct edges_t {
+  size_t num_samples;
+
+  // levels of all channels in the first sample
+  uint32_t initial;
+
+  // edge i of channel ch is at sample idx[ch][i], the sample with the new level
+  size_t* idx[EDGES_CHANNELS_MAX];
+  size_t num[EDGES_CHANNELS_MAX];
+};
+
+// index the channels selected by mask, returns EXIT_SUCCESS or EXIT_FAILURE if out of memory
+int edges_build(struct edges_t* edges, const uint32_t* samples, size_t num_samples, uint32_t mask);
+
+void edges_free(struct edges_t* edges);
+
+// sample index of the first edge after sample i, num_samples if there is none
+size_t edges_next(const struct edges_t* edges, unsigned int ch, size_t i);
+
+// number of edges in samples from - to, including from but not to
+size_t edges_count(const struct edges_t* edges, unsigned int ch, size_t from, size_t to);
+
+// level of the channel in sample i
+int edges_level(const struct edges_t* edges, unsigned int ch, size_t i);
+
+#endif
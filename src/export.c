@@ -0,0 +1,18 @@
+#include <string.h>
+
+#include "export.h"
+
+static const struct exporter_t* exporters[] = {
+  &exporter_sr,
+  &exporter_vcd,
+  &exporter_raw,
+};
+
+const struct exporter_t* export_find(const char* name) {
+  for(size_t i = 0; i < sizeof(exporters)/sizeof(exporters[0]); i++) {
+    if(strcmp(exporters[i]->name, name) == 0) {
+      return(exporters[i]);
+    }
+  }
+  return(NULL);
+}
@@ -0,0 +1,58 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdbool.h>
+
+#include "capture.h"
+
+// output options, not all formats support all of them
+struct export_opts_t {
+  // write asynchronously through io_uring
+  bool async;
+
+  // bypass the page cache (O_DIRECT), only with async writes
+  bool direct;
+
+  // store a min/max summary pyramid next to the samples, see summary.h
+  bool summary;
+};
+
+// output format writer, samples are streamed into it one segment at a time
+struct exporter_t {
+  // format name as used on the command line, and the file extension
+  const char* name;
+  const char* ext;
+
+  // number of bytes the writer will allocate from the arena for this capture
+  size_t (*mem_size)(const struct capture_t* cap, const struct export_opts_t* opts);
+
+  // create the output file, returns writer context or NULL on failure
+  // called before the capture is started, all buffers are allocated from the arena
+  void* (*open)(const char* filename, const struct capture_t* cap, const struct export_opts_t* opts);
+
+  // append one segment of samples, returns EXIT_SUCCESS or EXIT_FAILURE
+  int (*write)(void* ctx, const struct segment_t* seg);
+
+  // finalize the output file, returns EXIT_SUCCESS or EXIT_FAILURE
+  // arena memory used by the writer can be released after this
+  int (*close)(void* ctx);
+};
+
+extern const struct exporter_t exporter_sr;
+extern const struct exporter_t exporter_vcd;
+extern const struct exporter_t exporter_raw;
+
+// keeps all samples in memory instead of writing a file, used by sessions without output file
+extern const struct exporter_t exporter_mem;
+
+// converted samples of a memory exporter, valid until the arena is released
+const uint32_t* export_mem_samples(void* ctx);
+
+// generate the sigrok metadata file into buff of len bytes
+// returns the number of characters written, or -1 if it did not fit
+int export_sr_metadata(char* buff, size_t len, const struct capture_t* cap);
+
+// find exporter by name, returns NULL if there is no such format
+const struct exporter_t* export_find(const char* name);
+
+#endif
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "export.h"
+#include "arena.h"
+
+struct mem_ctx_t {
+  uint32_t* samples;
+  size_t num_samples;
+};
+
+static size_t mem_mem_size(const struct capture_t* cap, const struct export_opts_t* opts) {
+  (void)opts;
+  return(sizeof(struct mem_ctx_t) + cap->num_samples * sizeof(uint32_t) + ARENA_ALIGN_DEFAULT);
+}
+
+static void* mem_open(const char* filename, const struct capture_t* cap, const struct export_opts_t* opts) {
+  (void)filename;
+  (void)opts;
+  struct mem_ctx_t* ctx = arena_alloc(sizeof(struct mem_ctx_t), ARENA_ALIGN_DEFAULT);
+  if(!ctx) {
+    return(NULL);
+  }
+
+  ctx->num_samples = cap->num_samples;
+  ctx->samples = arena_alloc(cap->num_samples * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+  if(!ctx->samples) {
+    return(NULL);
+  }
+  return(ctx);
+}
+
+static int mem_write(void* ptr, const struct segment_t* seg) {
+  struct mem_ctx_t* ctx = (struct mem_ctx_t*)ptr;
+  if(seg->offset + seg->len > ctx->num_samples) {
+    fprintf(stderr, "Segment at %lu does not fit into %lu samples\n", seg->offset, ctx->num_samples);
+    return(EXIT_FAILURE);
+  }
+
+  memcpy(&ctx->samples[seg->offset], seg->samples, seg->len * sizeof(uint32_t));
+  return(EXIT_SUCCESS);
+}
+
+static int mem_close(void* ptr) {
+  (void)ptr;
+  return(EXIT_SUCCESS);
+}
+
+const uint32_t* export_mem_samples(void* ptr) {
+  return(((struct mem_ctx_t*)ptr)->samples);
+}
+
+const struct exporter_t exporter_mem = {
+  .name = "mem",
+  .ext = "",
+  .mem_size = mem_mem_size,
+  .open = mem_open,
+  .write = mem_write,
+  .close = mem_close,
+};
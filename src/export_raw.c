@@ -0,0 +1,300 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "export.h"
+#include "convert.h"
+#include "rawfmt.h"
+#include "uring.h"
+#include "arena.h"
+#include "summary.h"
+
+// packed samples are collected and written in blocks of this size
+#define RAW_WRITE_BLOCK_SIZE        (4UL*1024UL*1024UL)
+
+// number of blocks that can be in flight with asynchronous writes
+#define RAW_URING_DEPTH             (4)
+
+struct raw_ctx_t {
+  int fd;
+  const struct capture_t* cap;
+  unsigned int unitsize;
+  uint8_t* block;
+  size_t block_size;
+  size_t block_len;
+  off_t data_offset;
+  size_t num_samples;
+  struct uring_t* ring;
+  bool direct;
+
+  // NULL when not requested
+  struct summary_t* summary;
+  off_t summary_offset;
+};
+
+static void raw_put_le32(uint8_t* buff, size_t offset, uint32_t val) {
+  for(int i = 0; i < 4; i++) {
+    buff[offset + i] = (val >> (8*i)) & 0xFF;
+  }
+}
+
+static void raw_put_le64(uint8_t* buff, size_t offset, uint64_t val) {
+  for(int i = 0; i < 8; i++) {
+    buff[offset + i] = (val >> (8*i)) & 0xFF;
+  }
+}
+
+static int raw_pwrite(int fd, const uint8_t* buff, size_t len, off_t offset) {
+  while(len) {
+    ssize_t written = pwrite(fd, buff, len, offset);
+    if(written < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      perror("Failed to write raw file");
+      return(EXIT_FAILURE);
+    }
+    buff += written;
+    offset += written;
+    len -= written;
+  }
+  return(EXIT_SUCCESS);
+}
+
+// write len bytes from buff, which is the current block when using io_uring
+static int raw_output(struct raw_ctx_t* ctx, uint8_t* buff, size_t len, off_t offset) {
+  if(!ctx->ring) {
+    return(raw_pwrite(ctx->fd, buff, len, offset));
+  }
+
+  // with O_DIRECT the length must be aligned too, the file is truncated to the correct size at the end
+  if(ctx->direct && (len % RAW_ALIGN)) {
+    size_t padded = ((len + RAW_ALIGN - 1) / RAW_ALIGN) * RAW_ALIGN;
+    memset(&buff[len], 0, padded - len);
+    len = padded;
+  }
+
+  // the buffer now belongs to the ring until the write completes
+  if(uring_submit(ctx->ring, buff, len, offset) != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+  ctx->block = uring_get_buffer(ctx->ring);
+  return(ctx->block ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static int raw_flush(struct raw_ctx_t* ctx) {
+  if(!ctx->block_len) {
+    return(EXIT_SUCCESS);
+  }
+
+  size_t len = ctx->block_len;
+  ctx->block_len = 0;
+  int ret = raw_output(ctx, ctx->block, len, ctx->data_offset);
+  ctx->data_offset += len;
+  return(ret);
+}
+
+static int raw_write_header(struct raw_ctx_t* ctx) {
+  const struct capture_t* cap = ctx->cap;
+  uint8_t* hdr = ctx->block;
+  memset(hdr, 0, RAW_HEADER_LEN);
+
+  memcpy(&hdr[RAW_OFFS_MAGIC], RAW_MAGIC, sizeof(RAW_MAGIC));
+  raw_put_le32(hdr, RAW_OFFS_VERSION, RAW_VERSION);
+  raw_put_le32(hdr, RAW_OFFS_HEADER_LEN, RAW_HEADER_LEN);
+  raw_put_le32(hdr, RAW_OFFS_NUM_CHANNELS, cap->num_pins);
+  raw_put_le32(hdr, RAW_OFFS_UNITSIZE, ctx->unitsize);
+  raw_put_le64(hdr, RAW_OFFS_NUM_SAMPLES, ctx->num_samples);
+
+  uint64_t rate_bits;
+  memcpy(&rate_bits, &cap->samp_rate, sizeof(rate_bits));
+  raw_put_le64(hdr, RAW_OFFS_SAMP_RATE, rate_bits);
+
+  raw_put_le64(hdr, RAW_OFFS_TRIG_IDX, cap->trig_idx);
+  raw_put_le64(hdr, RAW_OFFS_START_SEC, cap->start.tv_sec);
+  raw_put_le64(hdr, RAW_OFFS_START_NSEC, cap->start.tv_nsec);
+  raw_put_le64(hdr, RAW_OFFS_END_SEC, cap->end.tv_sec);
+  raw_put_le64(hdr, RAW_OFFS_END_NSEC, cap->end.tv_nsec);
+
+  // section table, samples always go first
+  raw_put_le32(hdr, RAW_OFFS_NUM_SECTIONS, ctx->summary ? 2 : 1);
+  raw_put_le32(hdr, RAW_OFFS_SECTIONS, RAW_SECTION_SAMPLES);
+  raw_put_le64(hdr, RAW_OFFS_SECTIONS + 8, RAW_HEADER_LEN);
+  raw_put_le64(hdr, RAW_OFFS_SECTIONS + 16, (uint64_t)ctx->num_samples * ctx->unitsize);
+  if(ctx->summary) {
+    raw_put_le32(hdr, RAW_OFFS_SECTIONS + RAW_SECTION_LEN, RAW_SECTION_SUMMARY);
+    raw_put_le64(hdr, RAW_OFFS_SECTIONS + RAW_SECTION_LEN + 8, ctx->summary_offset);
+    raw_put_le64(hdr, RAW_OFFS_SECTIONS + RAW_SECTION_LEN + 16, ctx->summary->out_len);
+  }
+
+  for(unsigned int i = 0; (i < cap->num_pins) && (i < RAW_CHANNELS_MAX); i++) {
+    hdr[RAW_OFFS_PINS + i] = cap->pins[i];
+    strncpy((char*)&hdr[RAW_OFFS_LABELS + i*RAW_LABEL_LEN], cap->labels[i], RAW_LABEL_LEN - 1);
+  }
+
+  return(raw_output(ctx, hdr, RAW_HEADER_LEN, 0));
+}
+
+static size_t raw_mem_size(const struct capture_t* cap, const struct export_opts_t* opts) {
+  size_t size = sizeof(struct raw_ctx_t) + RAW_ALIGN + RAW_WRITE_BLOCK_SIZE * (opts->async ? RAW_URING_DEPTH : 1);
+  if(opts->summary) {
+    size += sizeof(struct summary_t) + ARENA_ALIGN_DEFAULT + summary_mem_size(cap);
+  }
+  return(size);
+}
+
+static void* raw_open(const char* filename, const struct capture_t* cap, const struct export_opts_t* opts) {
+  struct raw_ctx_t* ctx = arena_alloc(sizeof(struct raw_ctx_t), ARENA_ALIGN_DEFAULT);
+  if(!ctx) {
+    return(NULL);
+  }
+
+  ctx->cap = cap;
+  ctx->unitsize = (cap->num_pins + 7) / 8;
+  ctx->data_offset = RAW_HEADER_LEN;
+  ctx->direct = opts->async && opts->direct;
+
+  // blocks hold whole samples and are page-aligned in length
+  ctx->block_size = (RAW_WRITE_BLOCK_SIZE / (RAW_ALIGN * ctx->unitsize)) * RAW_ALIGN * ctx->unitsize;
+
+  // write blocks, page-aligned to allow O_DIRECT
+  uint8_t* blocks = arena_alloc(RAW_WRITE_BLOCK_SIZE * (opts->async ? RAW_URING_DEPTH : 1), RAW_ALIGN);
+  if(!blocks) {
+    return(NULL);
+  }
+
+  if(opts->summary) {
+    ctx->summary = arena_alloc(sizeof(struct summary_t), ARENA_ALIGN_DEFAULT);
+    if(!ctx->summary || (summary_init(ctx->summary, cap) != EXIT_SUCCESS)) {
+      return(NULL);
+    }
+  }
+
+  ctx->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | (ctx->direct ? O_DIRECT : 0), 0644);
+  if(ctx->fd < 0) {
+    fprintf(stderr, "Cannot open raw file %s\n", filename);
+    return(NULL);
+  }
+
+  if(opts->async) {
+    ctx->ring = uring_open(ctx->fd, RAW_URING_DEPTH, RAW_WRITE_BLOCK_SIZE, blocks);
+    if(ctx->ring) {
+      ctx->block = uring_get_buffer(ctx->ring);
+    } else {
+      fprintf(stderr, "io_uring is not available, falling back to synchronous writes\n");
+      if(ctx->direct) {
+        fcntl(ctx->fd, F_SETFL, fcntl(ctx->fd, F_GETFL) & ~O_DIRECT);
+        ctx->direct = false;
+      }
+    }
+  }
+
+  if(!ctx->ring) {
+    ctx->block = blocks;
+  }
+
+  if(!ctx->block) {
+    if(ctx->ring) { uring_close(ctx->ring); }
+    close(ctx->fd);
+    return(NULL);
+  }
+
+  return(ctx);
+}
+
+static int raw_write(void* ctx_ptr, const struct segment_t* seg) {
+  struct raw_ctx_t* ctx = (struct raw_ctx_t*)ctx_ptr;
+
+  // pack samples directly into the write block, flush it whenever full
+  size_t done = 0;
+  while(done < seg->len) {
+    size_t space = (ctx->block_size - ctx->block_len) / ctx->unitsize;
+    size_t len = seg->len - done;
+    if(len > space) { len = space; }
+    convert_pack(&seg->samples[done], &ctx->block[ctx->block_len], len, ctx->unitsize);
+    ctx->block_len += len * ctx->unitsize;
+    done += len;
+
+    if(ctx->block_len == ctx->block_size) {
+      if(raw_flush(ctx) != EXIT_SUCCESS) {
+        return(EXIT_FAILURE);
+      }
+    }
+  }
+
+  // while the segment is still in cache
+  if(ctx->summary) {
+    summary_update(ctx->summary, seg);
+  }
+
+  ctx->num_samples += seg->len;
+  return(EXIT_SUCCESS);
+}
+
+static int raw_close(void* ctx_ptr) {
+  struct raw_ctx_t* ctx = (struct raw_ctx_t*)ctx_ptr;
+  int ret = EXIT_SUCCESS;
+
+  // summary goes to the first page after the samples
+  if(ctx->summary) {
+    summary_finish(ctx->summary);
+    off_t end = RAW_HEADER_LEN + (off_t)ctx->num_samples * ctx->unitsize;
+    ctx->summary_offset = ((end + RAW_ALIGN - 1) / RAW_ALIGN) * RAW_ALIGN;
+  }
+
+  // header goes last, only now do we know the final sample count
+  if((raw_flush(ctx) != EXIT_SUCCESS) || (raw_write_header(ctx) != EXIT_SUCCESS)) {
+    ret = EXIT_FAILURE;
+  }
+
+  if(ctx->ring) {
+    if(uring_drain(ctx->ring) != EXIT_SUCCESS) {
+      ret = EXIT_FAILURE;
+    }
+
+    struct uring_stats_t stats;
+    uring_get_stats(ctx->ring, &stats);
+    double mbytes = (double)stats.bytes / (1024.0*1024.0);
+    fprintf(stdout, "io_uring: %.1f MiB in %.3f s (%.1f MiB/s), queue depth max %u, average %.1f\n",
+      mbytes, stats.seconds, (stats.seconds > 0) ? mbytes / stats.seconds : 0, stats.depth_max, stats.depth_avg);
+
+    // get rid of the padding
+    if(ctx->direct && (ftruncate(ctx->fd, RAW_HEADER_LEN + (off_t)ctx->num_samples * ctx->unitsize) != 0)) {
+      perror("Failed to truncate raw file");
+      ret = EXIT_FAILURE;
+    }
+
+    uring_close(ctx->ring);
+  }
+
+  // the summary is not page-sized, so it is written without O_DIRECT
+  if(ctx->summary) {
+    if(ctx->direct) {
+      fcntl(ctx->fd, F_SETFL, fcntl(ctx->fd, F_GETFL) & ~O_DIRECT);
+    }
+    if(raw_pwrite(ctx->fd, ctx->summary->out, ctx->summary->out_len, ctx->summary_offset) != EXIT_SUCCESS) {
+      ret = EXIT_FAILURE;
+    }
+  }
+
+  if(close(ctx->fd) != 0) {
+    perror("Failed to close raw file");
+    ret = EXIT_FAILURE;
+  }
+
+  return(ret);
+}
+
+const struct exporter_t exporter_raw = {
+  .name = "raw",
+  .ext = "raw",
+  .mem_size = raw_mem_size,
+  .open = raw_open,
+  .write = raw_write,
+  .close = raw_close,
+};
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <zip.h>
+
+#include "export.h"
+#include "convert.h"
+#include "arena.h"
+#include "summary.h"
+
+#define SIGROK_FILE_METADATA  \
+  "[global]\n" \
+  "sigrok version=0.6.0\n\n" \
+  "[device 1]\n" \
+  "capturefile=logic-1\n" \
+  "total probes=%d\n" \
+  "samplerate=%.6f MHz\n" \
+  "unitsize=%d\n" \
+  "total analog=0\n"
+
+// space for the metadata file, enough for all the probe labels
+#define SR_METADATA_LEN_MAX   4096
+
+struct sr_ctx_t {
+  zip_t* z;
+  unsigned int unitsize;
+
+  // the whole logic-1 file is packed here and handed over to libzip without copying
+  uint8_t* out;
+  size_t out_size;
+  size_t out_len;
+
+  // NULL when not requested, stored as an extra archive entry that sigrok ignores
+  struct summary_t* summary;
+};
+
+static int zip_add_entry(zip_t *z, char* name, void* data, size_t len) {
+  zip_source_t* src = zip_source_buffer(z, NULL, 0, 0);
+  if(!src) {
+    fprintf(stderr, "Failed to create source buffer: %s\n", zip_strerror(z));
+    return(EXIT_FAILURE);
+  }
+
+  if(zip_source_begin_write(src) < 0) {
+    fprintf(stderr, "zip_source_begin_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+    return(EXIT_FAILURE);
+  }
+
+  if(zip_source_write(src, data, len) < (zip_int64_t)len) {
+    fprintf(stderr, "zip_source_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+    zip_source_rollback_write(src);
+    return(EXIT_FAILURE);
+  }
+
+  if(zip_source_commit_write(src) < 0) {
+    fprintf(stderr, "zip_source_commit_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+    return(EXIT_FAILURE);
+  }
+
+  if(zip_file_add(z, name, src, ZIP_FL_OVERWRITE) < 0) {
+    fprintf(stderr, "Failed to add %s: %s\n", name, zip_strerror(z));
+    return(EXIT_FAILURE);
+  }
+
+  return(EXIT_SUCCESS);
+}
+
+int export_sr_metadata(char* buff, size_t len, const struct capture_t* cap) {
+  int written = snprintf(buff, len, SIGROK_FILE_METADATA, cap->num_pins, cap->samp_rate/1000000.0, (cap->num_pins + 7) / 8);
+  for(unsigned int i = 0; (i < cap->num_pins) && (written < (int)len); i++) {
+    written += snprintf(&buff[written], len - written, "probe%d=%s\n", (i + 1), cap->labels[i]);
+  }
+  return((written < (int)len) ? written : -1);
+}
+
+static size_t sr_mem_size(const struct capture_t* cap, const struct export_opts_t* opts) {
+  size_t size = sizeof(struct sr_ctx_t) + cap->num_samples * ((cap->num_pins + 7) / 8);
+  if(opts->summary) {
+    size += sizeof(struct summary_t) + ARENA_ALIGN_DEFAULT + summary_mem_size(cap);
+  }
+  return(size);
+}
+
+static void* sr_open(const char* filename, const struct capture_t* cap, const struct export_opts_t* opts) {
+  int err = 0;
+  zip_error_t zip_err;
+  zip_error_init(&zip_err);
+
+  struct sr_ctx_t* ctx = arena_alloc(sizeof(struct sr_ctx_t), ARENA_ALIGN_DEFAULT);
+  if(!ctx) {
+    return(NULL);
+  }
+  ctx->unitsize = (cap->num_pins + 7) / 8;
+  ctx->out_size = cap->num_samples * ctx->unitsize;
+  ctx->out = arena_alloc(ctx->out_size, ARENA_ALIGN_DEFAULT);
+  if(!ctx->out) {
+    return(NULL);
+  }
+  if(opts->summary) {
+    ctx->summary = arena_alloc(sizeof(struct summary_t), ARENA_ALIGN_DEFAULT);
+    if(!ctx->summary || (summary_init(ctx->summary, cap) != EXIT_SUCCESS)) {
+      return(NULL);
+    }
+  }
+
+  // create and open the archive
+  ctx->z = zip_open(filename, ZIP_CREATE | ZIP_TRUNCATE, &err);
+  if(!ctx->z) {
+    zip_error_init_with_code(&zip_err, err);
+    fprintf(stderr, "Cannot open zip file: %s\n", zip_error_strerror(&zip_err));
+    zip_error_fini(&zip_err);
+    return(NULL);
+  }
+
+  // add the metadata file
+  char workbuff[SR_METADATA_LEN_MAX] = { 0 };
+  int written = export_sr_metadata(workbuff, sizeof(workbuff), cap);
+  if(written < 0) {
+    fprintf(stderr, "Labels too long for the metadata file\n");
+    zip_discard(ctx->z);
+    return(NULL);
+  }
+  if(zip_add_entry(ctx->z, "metadata", workbuff, written) != EXIT_SUCCESS) {
+    zip_discard(ctx->z);
+    return(NULL);
+  }
+
+  // add the version file (yes, it is just a single number)
+  sprintf(workbuff, "2");
+  if(zip_add_entry(ctx->z, "version", workbuff, strlen(workbuff)) != EXIT_SUCCESS) {
+    zip_discard(ctx->z);
+    return(NULL);
+  }
+
+  return(ctx);
+}
+
+static int sr_write(void* ctx_ptr, const struct segment_t* seg) {
+  struct sr_ctx_t* ctx = (struct sr_ctx_t*)ctx_ptr;
+
+  // convert the whole segment to sigrok binary format
+  size_t offset = seg->offset * ctx->unitsize;
+  size_t len = seg->len * ctx->unitsize;
+  if(offset + len > ctx->out_size) {
+    fprintf(stderr, "Too many samples for the output buffer\n");
+    return(EXIT_FAILURE);
+  }
+  convert_pack(seg->samples, &ctx->out[offset], seg->len, ctx->unitsize);
+  if(offset + len > ctx->out_len) {
+    ctx->out_len = offset + len;
+  }
+  if(ctx->summary) {
+    summary_update(ctx->summary, seg);
+  }
+
+  return(EXIT_SUCCESS);
+}
+
+static int sr_close(void* ctx_ptr) {
+  struct sr_ctx_t* ctx = (struct sr_ctx_t*)ctx_ptr;
+
+  // add the samples straight from the packed buffer
+  zip_source_t* src = zip_source_buffer(ctx->z, ctx->out, ctx->out_len, 0);
+  if(!src) {
+    fprintf(stderr, "Failed to create source buffer: %s\n", zip_strerror(ctx->z));
+    zip_discard(ctx->z);
+    return(EXIT_FAILURE);
+  }
+
+  // dump everything into the same file
+  if(zip_file_add(ctx->z, "logic-1", src, ZIP_FL_OVERWRITE) < 0) {
+    fprintf(stderr, "Failed to add samples: %s\n", zip_strerror(ctx->z));
+    zip_source_free(src);
+    zip_discard(ctx->z);
+    return(EXIT_FAILURE);
+  }
+
+  if(ctx->summary) {
+    summary_finish(ctx->summary);
+    src = zip_source_buffer(ctx->z, ctx->summary->out, ctx->summary->out_len, 0);
+    if(!src || (zip_file_add(ctx->z, "summary-1", src, ZIP_FL_OVERWRITE) < 0)) {
+      fprintf(stderr, "Failed to add summary: %s\n", zip_strerror(ctx->z));
+      if(src) { zip_source_free(src); }
+      zip_discard(ctx->z);
+      return(EXIT_FAILURE);
+    }
+  }
+
+  // all done, close the archive
+  if(zip_close(ctx->z) < 0) {
+    fprintf(stderr, "Failed to close zip archive: %s\n", zip_strerror(ctx->z));
+    zip_discard(ctx->z);
+    return(EXIT_FAILURE);
+  }
+
+  return(EXIT_SUCCESS);
+}
+
+const struct exporter_t exporter_sr = {
+  .name = "sr",
+  .ext = "sr",
+  .mem_size = sr_mem_size,
+  .open = sr_open,
+  .write = sr_write,
+  .close = sr_close,
+};
@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "export.h"
+#include "arena.h"
+
+// size of the stdio buffer used for the output file
+// value changes are small, so only flush to disk in large blocks
+#define VCD_WRITE_BUFF_SIZE   (1024UL*1024UL)
+
+// VCD timescale, timestamps are in nanoseconds
+#define VCD_TIMESCALE_NS      1.0e9
+
+// identifier codes are single printable characters starting at '!'
+#define VCD_ID(ch)            ((char)('!' + (ch)))
+
+struct vcd_ctx_t {
+  FILE* fp;
+  const struct capture_t* cap;
+  char* buff;
+  uint32_t mask;
+  uint32_t prev;
+  double ns_per_sample;
+  size_t num_samples;
+};
+
+// write unsigned number, fprintf is too slow for the amount of timestamps
+static void vcd_put_u64(FILE* fp, uint64_t val) {
+  char str[24];
+  int pos = sizeof(str);
+  do {
+    str[--pos] = '0' + (val % 10);
+    val /= 10;
+  } while(val);
+  fwrite(&str[pos], 1, sizeof(str) - pos, fp);
+}
+
+static void vcd_put_time(struct vcd_ctx_t* ctx, size_t idx) {
+  putc_unlocked('#', ctx->fp);
+  vcd_put_u64(ctx->fp, (uint64_t)llround((double)idx * ctx->ns_per_sample));
+  putc_unlocked('\n', ctx->fp);
+}
+
+static void vcd_put_change(struct vcd_ctx_t* ctx, unsigned int ch, uint32_t sample) {
+  putc_unlocked((sample & (1UL << ch)) ? '1' : '0', ctx->fp);
+  putc_unlocked(VCD_ID(ch), ctx->fp);
+  putc_unlocked('\n', ctx->fp);
+}
+
+static size_t vcd_mem_size(const struct capture_t* cap, const struct export_opts_t* opts) {
+  (void)cap;
+  (void)opts;
+  return(sizeof(struct vcd_ctx_t) + VCD_WRITE_BUFF_SIZE);
+}
+
+// the header is written with the first samples, only then is the capture start time known
+static void vcd_put_header(struct vcd_ctx_t* ctx) {
+  const struct capture_t* cap = ctx->cap;
+  ctx->ns_per_sample = VCD_TIMESCALE_NS / cap->samp_rate;
+
+  char date[64];
+  struct tm tm;
+  gmtime_r(&cap->start.tv_sec, &tm);
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S UTC", &tm);
+  fprintf(ctx->fp, "$date %s $end\n", date);
+  fprintf(ctx->fp, "$version pinalyzer, %.6f MHz $end\n", cap->samp_rate/1000000.0);
+  fprintf(ctx->fp, "$timescale 1 ns $end\n");
+  fprintf(ctx->fp, "$scope module pinalyzer $end\n");
+  for(unsigned int i = 0; i < cap->num_pins; i++) {
+    // reference names can not contain whitespace
+    fprintf(ctx->fp, "$var wire 1 %c ", VCD_ID(i));
+    for(const char* c = cap->labels[i]; *c; c++) {
+      putc_unlocked((*c == ' ') || (*c == '\t') ? '_' : *c, ctx->fp);
+    }
+    fprintf(ctx->fp, " $end\n");
+  }
+  fprintf(ctx->fp, "$upscope $end\n");
+  fprintf(ctx->fp, "$enddefinitions $end\n");
+}
+
+static void* vcd_open(const char* filename, const struct capture_t* cap, const struct export_opts_t* opts) {
+  (void)opts;
+  struct vcd_ctx_t* ctx = arena_alloc(sizeof(struct vcd_ctx_t), ARENA_ALIGN_DEFAULT);
+  if(!ctx) {
+    return(NULL);
+  }
+
+  // use a large buffer, this will be mostly sequential writes of a few bytes each
+  ctx->buff = arena_alloc(VCD_WRITE_BUFF_SIZE, ARENA_ALIGN_DEFAULT);
+  if(!ctx->buff) {
+    return(NULL);
+  }
+
+  ctx->fp = fopen(filename, "w");
+  if(!ctx->fp) {
+    fprintf(stderr, "Cannot open VCD file %s\n", filename);
+    return(NULL);
+  }
+  setvbuf(ctx->fp, ctx->buff, _IOFBF, VCD_WRITE_BUFF_SIZE);
+
+  ctx->cap = cap;
+  ctx->mask = (cap->num_pins >= 32) ? 0xFFFFFFFFUL : ((1UL << cap->num_pins) - 1);
+
+  return(ctx);
+}
+
+static int vcd_write(void* ctx_ptr, const struct segment_t* seg) {
+  struct vcd_ctx_t* ctx = (struct vcd_ctx_t*)ctx_ptr;
+  size_t i = 0;
+
+  // dump initial values of all channels
+  if((seg->offset == 0) && seg->len) {
+    uint32_t sample = seg->samples[0] & ctx->mask;
+    vcd_put_header(ctx);
+    fprintf(ctx->fp, "#0\n$dumpvars\n");
+    for(unsigned int ch = 0; ch < 32; ch++) {
+      if(ctx->mask & (1UL << ch)) {
+        vcd_put_change(ctx, ch, sample);
+      }
+    }
+    fprintf(ctx->fp, "$end\n");
+    ctx->prev = sample;
+    i = 1;
+  }
+
+  // now only the value changes
+  for(; i < seg->len; i++) {
+    uint32_t sample = seg->samples[i] & ctx->mask;
+    uint32_t diff = sample ^ ctx->prev;
+    if(!diff) {
+      continue;
+    }
+
+    vcd_put_time(ctx, seg->offset + i);
+    while(diff) {
+      unsigned int ch = __builtin_ctz(diff);
+      vcd_put_change(ctx, ch, sample);
+      diff &= diff - 1;
+    }
+    ctx->prev = sample;
+  }
+
+  ctx->num_samples = seg->offset + seg->len;
+  if(ferror(ctx->fp)) {
+    fprintf(stderr, "Failed to write VCD file\n");
+    return(EXIT_FAILURE);
+  }
+
+  return(EXIT_SUCCESS);
+}
+
+static int vcd_close(void* ctx_ptr) {
+  struct vcd_ctx_t* ctx = (struct vcd_ctx_t*)ctx_ptr;
+  int ret = EXIT_SUCCESS;
+
+  // final timestamp so that viewers show the full capture length
+  vcd_put_time(ctx, ctx->num_samples);
+  int err = ferror(ctx->fp);
+  if((fclose(ctx->fp) != 0) || err) {
+    fprintf(stderr, "Failed to close VCD file\n");
+    ret = EXIT_FAILURE;
+  }
+
+  return(ret);
+}
+
+const struct exporter_t exporter_vcd = {
+  .name = "vcd",
+  .ext = "vcd",
+  .mem_size = vcd_mem_size,
+  .open = vcd_open,
+  .write = vcd_write,
+  .close = vcd_close,
+};
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/stat.h>
+
+#include "monitor.h"
+#include "pipeline.h"
+#include "spsc.h"
+#include "arena.h"
+#include "timing.h"
+#include "outpath.h"
+
+// how long to sleep when there is nothing to do
+#define MONITOR_POLL_US             (1000)
+
+// extra arena space for small allocations of the exporters
+#define MONITOR_ARENA_SLACK         (64UL*1024UL)
+
+struct monitor_job_t {
+  struct capture_t cap;
+  uint32_t* samples;
+  char tmpname[MONITOR_NAME_LEN];
+  char filename[MONITOR_NAME_LEN];
+};
+
+struct monitor_file_t {
+  char name[MONITOR_NAME_LEN];
+  uint64_t size;
+};
+
+static struct monitor_t {
+  struct monitor_conf_t conf;
+  struct monitor_job_t jobs[MONITOR_NUM_BUFFERS];
+
+  // free -> write -> free, the write queue also has room for the end marker
+  struct spsc_t q_free;
+  struct spsc_t q_write;
+  void* q_free_slots[MONITOR_NUM_BUFFERS];
+  void* q_write_slots[2*MONITOR_NUM_BUFFERS];
+
+  // the exporters allocate from the arena, the writer has its own so that the capture can release the shared one
+  struct arena_t arena;
+  pthread_t thread;
+  bool running;
+  int ret;
+
+  // files written so far, oldest first
+  struct monitor_file_t* files;
+  size_t num_files;
+  uint64_t total_bytes;
+
+  struct monitor_stats_t stats;
+} mon = {
+  .running = false,
+};
+
+static int monitor_write(struct monitor_job_t* job) {
+  const struct exporter_t* exporter = mon.conf.exporter;
+  size_t mark = arena_mark();
+  void* ctx = exporter->open(job->tmpname, &job->cap, &mon.conf.export_opts);
+  if(!ctx) {
+    arena_release(mark);
+    return(EXIT_FAILURE);
+  }
+
+  // same segments as the capture pipeline would produce
+  int ret = EXIT_SUCCESS;
+  for(size_t offset = 0; (offset < job->cap.num_samples) && (ret == EXIT_SUCCESS); offset += PIPELINE_SEGMENT_SAMPLES) {
+    struct segment_t seg = { .samples = &job->samples[offset], .offset = offset, .len = job->cap.num_samples - offset };
+    if(seg.len > PIPELINE_SEGMENT_SAMPLES) { seg.len = PIPELINE_SEGMENT_SAMPLES; }
+    ret = exporter->write(ctx, &seg);
+  }
+  if(exporter->close(ctx) != EXIT_SUCCESS) {
+    ret = EXIT_FAILURE;
+  }
+  arena_release(mark);
+
+  // only complete files get their final name
+  if(ret != EXIT_SUCCESS) {
+    unlink(job->tmpname);
+    return(ret);
+  }
+  return(outpath_commit(job->tmpname, job->filename));
+}
+
+// remember the new file and delete the oldest ones over the limits, but never the one just written
+static void monitor_rotate(const char* filename) {
+  struct stat st;
+  uint64_t size = (stat(filename, &st) == 0) ? (uint64_t)st.st_size : 0;
+  struct monitor_file_t* files = realloc(mon.files, (mon.num_files + 1) * sizeof(struct monitor_file_t));
+  if(!files) {
+    return;
+  }
+  mon.files = files;
+  snprintf(mon.files[mon.num_files].name, MONITOR_NAME_LEN, "%s", filename);
+  mon.files[mon.num_files].size = size;
+  mon.num_files++;
+  mon.total_bytes += size;
+  mon.stats.files++;
+  mon.stats.bytes += size;
+
+  size_t num_deleted = 0;
+  while((mon.num_files - num_deleted > 1) &&
+    ((mon.conf.max_files && (mon.num_files - num_deleted > mon.conf.max_files)) || (mon.conf.max_bytes && (mon.total_bytes > mon.conf.max_bytes)))) {
+    struct monitor_file_t* oldest = &mon.files[num_deleted++];
+    if(unlink(oldest->name) != 0) {
+      perror("Failed to delete old capture");
+    }
+    mon.total_bytes -= oldest->size;
+    mon.stats.deleted++;
+  }
+  mon.num_files -= num_deleted;
+  memmove(mon.files, &mon.files[num_deleted], mon.num_files * sizeof(struct monitor_file_t));
+}
+
+static void* monitor_writer(void* arg) {
+  (void)arg;
+  arena_select(&mon.arena);
+  struct monitor_job_t* job;
+  while(true) {
+    if(!spsc_pop(&mon.q_write, (void**)&job)) {
+      usleep(MONITOR_POLL_US);
+      continue;
+    }
+    if(!job) {
+      break;
+    }
+
+    double start = timing_now();
+    if(monitor_write(job) == EXIT_SUCCESS) {
+      monitor_rotate(job->filename);
+      fprintf(stdout, "%lu samples saved to %s in %.3f ms\n", job->cap.num_samples, job->filename, (timing_now() - start)*1000.0);
+    } else {
+      fprintf(stderr, "Failed to save %lu samples to %s\n", job->cap.num_samples, job->filename);
+      __atomic_store_n(&mon.ret, EXIT_FAILURE, __ATOMIC_RELAXED);
+    }
+    mon.stats.write_time += timing_now() - start;
+    spsc_push(&mon.q_free, job);
+  }
+  return(NULL);
+}
+
+int monitor_start(const struct monitor_conf_t* conf, const struct capture_t* cap) {
+  memset(&mon.stats, 0, sizeof(mon.stats));
+  mon.conf = *conf;
+  mon.ret = EXIT_SUCCESS;
+  spsc_init(&mon.q_free, mon.q_free_slots, MONITOR_NUM_BUFFERS);
+  spsc_init(&mon.q_write, mon.q_write_slots, 2*MONITOR_NUM_BUFFERS);
+  for(int i = 0; i < MONITOR_NUM_BUFFERS; i++) {
+    mon.jobs[i].samples = malloc(cap->num_samples * sizeof(uint32_t));
+    if(!mon.jobs[i].samples) {
+      fprintf(stderr, "Failed to allocate monitor buffers\n");
+      return(EXIT_FAILURE);
+    }
+    spsc_push(&mon.q_free, &mon.jobs[i]);
+  }
+
+  // the writer arena is set up here, so that failures show up before the first capture
+  arena_select(&mon.arena);
+  int ret = arena_init(conf->exporter->mem_size(cap, &conf->export_opts) + MONITOR_ARENA_SLACK);
+  arena_select(NULL);
+  if(ret != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+
+  if(pthread_create(&mon.thread, NULL, monitor_writer, NULL) != 0) {
+    fprintf(stderr, "Failed to start monitor writer\n");
+    return(EXIT_FAILURE);
+  }
+  mon.running = true;
+  return(EXIT_SUCCESS);
+}
+
+int monitor_submit(const struct capture_t* cap, const uint32_t* samples, const char* tmpname, const char* filename) {
+  struct monitor_job_t* job;
+  double start = timing_now();
+  while(!spsc_pop(&mon.q_free, (void**)&job)) {
+    usleep(MONITOR_POLL_US);
+  }
+  mon.stats.wait_time += timing_now() - start;
+
+  job->cap = *cap;
+  memcpy(job->samples, samples, cap->num_samples * sizeof(uint32_t));
+  snprintf(job->tmpname, MONITOR_NAME_LEN, "%s", tmpname);
+  snprintf(job->filename, MONITOR_NAME_LEN, "%s", filename);
+  spsc_push(&mon.q_write, job);
+
+  // failures are reported by the writer thread
+  return(__atomic_load_n(&mon.ret, __ATOMIC_RELAXED));
+}
+
+int monitor_stop() {
+  if(mon.running) {
+    spsc_push(&mon.q_write, NULL);
+    pthread_join(mon.thread, NULL);
+    mon.running = false;
+  }
+
+  arena_select(&mon.arena);
+  arena_free();
+  arena_select(NULL);
+  for(int i = 0; i < MONITOR_NUM_BUFFERS; i++) {
+    free(mon.jobs[i].samples);
+    mon.jobs[i].samples = NULL;
+  }
+  free(mon.files);
+  mon.files = NULL;
+  mon.num_files = 0;
+  mon.total_bytes = 0;
+  return(mon.ret);
+}
+
+void monitor_get_stats(struct monitor_stats_t* stats) {
+  memcpy(stats, &mon.stats, sizeof(mon.stats));
+}
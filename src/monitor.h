@@ -0,0 +1,47 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+#include "export.h"
+#include "outpath.h"
+
+// number of captures that can wait for the background writer, must be a power of 2
+#define MONITOR_NUM_BUFFERS         (2)
+
+#define MONITOR_NAME_LEN            OUTPATH_LEN_MAX
+
+struct monitor_conf_t {
+  const struct exporter_t* exporter;
+  struct export_opts_t export_opts;
+
+  // oldest files written by the monitor are deleted when there are more of them, or they are bigger in total, 0 for no limit
+  unsigned int max_files;
+  uint64_t max_bytes;
+};
+
+struct monitor_stats_t {
+  unsigned int files;
+  unsigned int deleted;
+  uint64_t bytes;
+
+  // time spent by the writer, and by the capture waiting for a free buffer
+  double write_time;
+  double wait_time;
+};
+
+// allocate buffers for captures described by cap and start the background writer
+int monitor_start(const struct monitor_conf_t* conf, const struct capture_t* cap);
+
+// copy a finished capture and queue it for writing to tmpname, which is renamed to filename when complete
+// waits only if all buffers are still being written
+int monitor_submit(const struct capture_t* cap, const uint32_t* samples, const char* tmpname, const char* filename);
+
+// write everything that is queued and stop the writer, returns EXIT_FAILURE if any of the files failed
+int monitor_stop();
+
+void monitor_get_stats(struct monitor_stats_t* stats);
+
+#endif
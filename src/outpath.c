@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "outpath.h"
+
+int outpath_mkdir(const char* dir) {
+  char path[OUTPATH_LEN_MAX];
+  if(snprintf(path, sizeof(path), "%s", dir) >= (int)sizeof(path)) {
+    fprintf(stderr, "Output directory name too long: %s\n", dir);
+    return(EXIT_FAILURE);
+  }
+  if(path[0] == '\0') {
+    fprintf(stderr, "Output directory name is empty\n");
+    return(EXIT_FAILURE);
+  }
+
+  // every parent first, then the directory itself
+  for(char* p = &path[1]; ; p++) {
+    if((*p != '/') && (*p != '\0')) {
+      continue;
+    }
+    char c = *p;
+    *p = '\0';
+    if((mkdir(path, 0755) != 0) && (errno != EEXIST)) {
+      fprintf(stderr, "Failed to create directory %s: %s\n", path, strerror(errno));
+      return(EXIT_FAILURE);
+    }
+    *p = c;
+    if(c == '\0') {
+      break;
+    }
+  }
+  return(EXIT_SUCCESS);
+}
+
+int outpath_check(const char* dir, const char* tmpl) {
+  if((dir[0] == '\0') || (tmpl[0] == '\0')) {
+    fprintf(stderr, "Output directory and file name template must not be empty\n");
+    return(EXIT_FAILURE);
+  }
+  char buff[OUTPATH_LEN_MAX];
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = 0 };
+  return(outpath_format(buff, sizeof(buff), dir, tmpl, "ext", 0, &ts, 0));
+}
+
+int outpath_format(char* buff, size_t len, const char* dir, const char* tmpl, const char* ext,
+  unsigned int seq, const struct timespec* ts, size_t trig_idx) {
+  size_t pos = snprintf(buff, len, "%s/", dir);
+  for(const char* p = tmpl; *p && (pos < len); ) {
+    if(*p != '{') {
+      buff[pos++] = *p++;
+      continue;
+    }
+
+    const char* end = strchr(p, '}');
+    size_t name_len = end ? (size_t)(end - p - 1) : 0;
+    int written;
+    if((name_len == 3) && (strncmp(&p[1], "seq", 3) == 0)) {
+      written = snprintf(&buff[pos], len - pos, "%06u", seq);
+    } else if((name_len == 3) && (strncmp(&p[1], "sec", 3) == 0)) {
+      written = snprintf(&buff[pos], len - pos, "%lu", (unsigned long)ts->tv_sec);
+    } else if((name_len == 4) && (strncmp(&p[1], "nsec", 4) == 0)) {
+      written = snprintf(&buff[pos], len - pos, "%09ld", ts->tv_nsec);
+    } else if((name_len == 4) && (strncmp(&p[1], "trig", 4) == 0)) {
+      written = snprintf(&buff[pos], len - pos, "%lu", trig_idx);
+    } else if((name_len == 3) && (strncmp(&p[1], "ext", 3) == 0)) {
+      written = snprintf(&buff[pos], len - pos, "%s", ext);
+    } else {
+      fprintf(stderr, "Unknown placeholder in file name template: %s\n", p);
+      return(EXIT_FAILURE);
+    }
+    pos += written;
+    p = end + 1;
+  }
+
+  if(pos >= len) {
+    fprintf(stderr, "File name too long: %s/%s\n", dir, tmpl);
+    return(EXIT_FAILURE);
+  }
+  buff[pos] = '\0';
+  return(EXIT_SUCCESS);
+}
+
+int outpath_temp(char* buff, size_t len, const char* dir, unsigned int seq, const char* ext) {
+  if(snprintf(buff, len, "%s/.pinalyzer_%d_%06u.%s.tmp", dir, (int)getpid(), seq, ext) >= (int)len) {
+    fprintf(stderr, "Output directory name too long: %s\n", dir);
+    return(EXIT_FAILURE);
+  }
+  return(EXIT_SUCCESS);
+}
+
+int outpath_commit(const char* tmp, const char* path) {
+  // file systems without RENAME_NOREPLACE still refuse to replace a file with link
+  int ret = renameat2(AT_FDCWD, tmp, AT_FDCWD, path, RENAME_NOREPLACE);
+  if((ret != 0) && ((errno == EINVAL) || (errno == ENOSYS))) {
+    ret = link(tmp, path);
+    if(ret == 0) {
+      unlink(tmp);
+    }
+  }
+
+  if(ret != 0) {
+    if(errno == EEXIST) {
+      fprintf(stderr, "Not replacing existing %s, output kept as %s\n", path, tmp);
+    } else {
+      fprintf(stderr, "Failed to rename %s to %s: %s, output kept\n", tmp, path, strerror(errno));
+    }
+    return(EXIT_FAILURE);
+  }
+  return(EXIT_SUCCESS);
+}
@@ -0,0 +1,40 @@
+#ifndef OUTPATH_H
+#define OUTPATH_H
+
+#include <stddef.h>
+#include <time.h>
+
+/*
+  Output file names are made from a template with these placeholders:
+  {seq}   sequence number of the capture within this run, 6 digits, starts at 0 on every run
+  {sec}   capture start, seconds since epoch
+  {nsec}  capture start, nanoseconds within the second, 9 digits
+  {trig}  index of the trigger sample
+  {ext}   file extension of the output format
+
+  Files are written under a temporary name in the same directory first, and renamed once complete,
+  so that anything watching the directory only ever sees finished files. Existing files are never replaced,
+  if the name is taken, the output stays under the temporary name.
+*/
+
+#define OUTPATH_DIR_DEFAULT         "out"
+#define OUTPATH_TEMPLATE_DEFAULT    "pinalyzer_{sec}_{nsec}.{ext}"
+#define OUTPATH_LEN_MAX             (256)
+
+// create the directory and all of its parents, returns EXIT_SUCCESS or EXIT_FAILURE
+int outpath_mkdir(const char* dir);
+
+// check that the template only has known placeholders and fits into OUTPATH_LEN_MAX
+int outpath_check(const char* dir, const char* tmpl);
+
+// file name from the template, returns EXIT_FAILURE if it does not fit into len bytes
+int outpath_format(char* buff, size_t len, const char* dir, const char* tmpl, const char* ext,
+  unsigned int seq, const struct timespec* ts, size_t trig_idx);
+
+// temporary name to write capture seq to, hidden in the output directory
+int outpath_temp(char* buff, size_t len, const char* dir, unsigned int seq, const char* ext);
+
+// move the finished file from its temporary to the final name, fails without removing tmp if path exists
+int outpath_commit(const char* tmp, const char* path);
+
+#endif
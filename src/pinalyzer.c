@@ -4,16 +4,30 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
 
-#include <sys/mman.h>
-#include <fcntl.h>
-
-#include <zip.h>
+#include <sys/stat.h>
 
 #include "argtable3/argtable3.h"
 #include "dma/dma.h"
-#include "dma/registers.h"
+#include "dma/hal.h"
+#include "dma/board.h"
+
+#include "capture.h"
+#include "export.h"
+#include "pipeline.h"
+#include "trigger.h"
+#include "timing.h"
+#include "probe.h"
+#include "session.h"
+#include "decode.h"
+#include "sigstats.h"
+#include "replay.h"
+#include "compare.h"
+#include "monitor.h"
+#include "outpath.h"
+#include "arena.h"
 
 // gitrev identification from CMake
 #ifndef GITREV
@@ -24,54 +38,75 @@
 #define STR_HELPER(s) #s    
 #define STR(s) STR_HELPER(s)     
 
-#define SAMPLE_RATE_MAX             5000000
-#define SAMPLE_RATE_NO_THROTTLE     1000000
-
-// use the maximum possible sampling rate by default
-#define SAMPLE_RATE_DEFAULT         SAMPLE_RATE_MAX
-
 // default capture length in milliseconds
 #define CAPTURE_LEN_DEFAULT         50
 
-// maximum number of pins we support
-// no point in having more since only GPIO 0..31 are accessible on the header
-#define PINS_MAX                    32
-
-// this will later point to memory-mapped GPIO registers
-static volatile unsigned int* gpio;
-
-#define SIGROK_FILE_METADATA  \
-  "[global]\n" \
-  "sigrok version=0.6.0\n\n" \
-  "[device 1]\n" \
-  "capturefile=logic-1\n" \
-  "total probes=%d\n" \
-  "samplerate=%.6f MHz\n" \
-  "unitsize=1\n" \
-  "total analog=0\n"
-
-enum trig_type_e {
-  TRIG_TYPE_RISING = 0,
-  TRIG_TYPE_FALLING,
-  TRIG_TYPE_ANY,
-  TRIG_TYPE_IMMEDIATE,
-};
+// length and number of runs of each setting in rate probing mode
+#define PROBE_SAMPLES               (512UL*DMA_TIMESTAMP_INTERVAL)
+#define PROBE_RUNS                  (3)
+
+// maximum number of protocol decoders run after a single capture
+#define DECODERS_MAX                8
+
+// defaults of the comparison with a golden reference
+#define COMPARE_JITTER_DEFAULT      2
+#define COMPARE_MAX_DEFAULT         10
+
+// extra arena space for small allocations of the exporters when replaying
+#define REPLAY_ARENA_SLACK          (64UL*1024UL)
 
 // app configuration structure
 static struct conf_t {
   int capture_len;
-  size_t num_samples;
-  enum trig_type_e trig;
-  int pins[PINS_MAX];
-  unsigned int num_pins;
+  const char* labels[SESSION_PINS_MAX];
+  const char* stats_json;
+  struct session_conf_t session;
+  const char* decode_out;
+  enum decode_fmt_e decode_fmt;
+  bool signal_stats;
+  const char* signal_stats_json;
+  const char* compare;
+  unsigned int compare_jitter;
+  unsigned int compare_max;
+  bool monitor;
+  unsigned int monitor_count;
+  struct monitor_conf_t monitor_conf;
+  const char* out_dir;
+  const char* out_name;
 } conf = {
   .capture_len = CAPTURE_LEN_DEFAULT,
-  .num_samples = SAMPLE_RATE_MAX,
-  .trig = TRIG_TYPE_RISING,
-  .pins = { 0 },
-  .num_pins = 0,
+  .labels = { NULL },
+  .stats_json = NULL,
+  .session = {
+    .pins = NULL,
+    .num_pins = 0,
+    .labels = NULL,
+    .rate = 0,
+    .num_samples = 0,
+    .trig = TRIG_TYPE_RISING,
+    .dma_opts = DMA_OPTS_DEFAULT,
+    .exporter = &exporter_sr,
+    .filename = NULL,
+    .export_opts = { .async = false, .direct = false, .summary = false },
+    .verbose = true,
+  },
+  .decode_out = "-",
+  .decode_fmt = DECODE_FMT_CSV,
+  .signal_stats = false,
+  .signal_stats_json = NULL,
+  .compare = NULL,
+  .compare_jitter = COMPARE_JITTER_DEFAULT,
+  .compare_max = COMPARE_MAX_DEFAULT,
+  .monitor = false,
+  .monitor_count = 0,
+  .monitor_conf = { .max_files = 0, .max_bytes = 0 },
+  .out_dir = OUTPATH_DIR_DEFAULT,
+  .out_name = OUTPATH_TEMPLATE_DEFAULT,
 };
 
+// transitions of the golden reference, loaded before the capture
+static struct compare_ref_t compare_ref;
+
 // argtable arguments
 static struct args_t {
   struct arg_int* pins;
@@ -79,6 +114,31 @@ static struct args_t {
   struct arg_int* capture_len;
   struct arg_str* trig_type;
   struct arg_str* labels;
+  struct arg_str* format;
+  struct arg_lit* io_uring;
+  struct arg_lit* direct;
+  struct arg_lit* summary;
+  struct arg_file* sim;
+  struct arg_file* stats_json;
+  struct arg_int* dma_priority;
+  struct arg_int* dma_panic_priority;
+  struct arg_lit* no_wait_resp;
+  struct arg_lit* probe_rate;
+  struct arg_file* dt_root;
+  struct arg_file* replay;
+  struct arg_str* decode;
+  struct arg_file* decode_out;
+  struct arg_str* decode_format;
+  struct arg_lit* signal_stats;
+  struct arg_file* signal_stats_json;
+  struct arg_file* compare;
+  struct arg_int* compare_jitter;
+  struct arg_int* compare_max;
+  struct arg_int* monitor;
+  struct arg_int* max_files;
+  struct arg_int* max_mbytes;
+  struct arg_str* out_dir;
+  struct arg_str* out_name;
   struct arg_lit* help;
   struct arg_end* end;
 } args;
@@ -93,188 +153,495 @@ static void exithandler(void) {
   fflush(stdout);
 }
 
-static int get_gpio(int pin) {
-  return((*(gpio + GPLEV0/sizeof(uint32_t)) & (1 << (pin & 31))) != 0);
+// detect the board, simulation can run without device tree
+static int init_board(const char* dt_root, bool sim) {
+  if(board_init(dt_root) != 0) {
+    if(!sim) {
+      return(EXIT_FAILURE);
+    }
+    fprintf(stderr, "Board detection failed, simulating the default board\n");
+    board_use_default();
+  }
+
+  const struct board_t* board = board_get();
+  fprintf(stdout, "Board: %s (%s, peripherals at 0x%08X, oscillator %.1f MHz, PLLD %.1f MHz)\n",
+    board->model, board->soc, board->periph_base, board->osc_freq / 1e6, board->plld_freq / 1e6);
+  return(EXIT_SUCCESS);
 }
 
-static void wait_for_trigger() {
-  bool triggered = false;
-  int curr;
-  int prev = get_gpio(conf.pins[0]);
-  while(!triggered) {
-    curr = get_gpio(conf.pins[0]);
-    switch((int)conf.trig) {
-      case TRIG_TYPE_ANY:
-        triggered = (curr != prev);
-        break;
-      case TRIG_TYPE_RISING:
-        triggered = ((prev == 0) && (curr == 1));
-        break;
-      case TRIG_TYPE_FALLING:
-        triggered = ((prev == 1) && (curr == 0));
-        break;
+static void print_pipeline_stats() {
+  struct pipeline_stats_t stats;
+  pipeline_get_stats(&stats);
+  for(int i = 0; i < PIPELINE_NUM_STAGES; i++) {
+    struct pipeline_stage_stats_t* st = &stats.stages[i];
+    fprintf(stdout, "Stage %-8s %lu segments, %lu input stalls, %lu output stalls, max occupancy %lu\n",
+      st->name, st->segments, st->stalls_in, st->stalls_out, st->occupancy_max);
+  }
+}
+
+// run all requested decoders over the captured samples
+static int decode(const struct segment_t* view, const struct edges_t* edges, const struct decoder_t** decoders, void** ctxs) {
+  struct decode_out_t out = { .fp = stdout, .fmt = conf.decode_fmt };
+  if(strcmp(conf.decode_out, "-") != 0) {
+    out.fp = fopen(conf.decode_out, (conf.decode_fmt == DECODE_FMT_BIN) ? "wb" : "w");
+    if(!out.fp) {
+      fprintf(stderr, "Failed to open %s\n", conf.decode_out);
+      return(EXIT_FAILURE);
     }
-    prev = curr;
   }
+
+  int ret = EXIT_SUCCESS;
+  for(int i = 0; i < args.decode->count; i++) {
+    double start = timing_now();
+    if(decoders[i]->run(ctxs[i], view->samples, view->len, edges, &out) != EXIT_SUCCESS) {
+      fprintf(stderr, "Failed to decode %s\n", args.decode->sval[i]);
+      ret = EXIT_FAILURE;
+      break;
+    }
+    fprintf(stderr, "Decoded %s in %.3f ms\n", decoders[i]->name, (timing_now() - start)*1000.0);
+  }
+
+  if(out.fp != stdout) {
+    fclose(out.fp);
+  } else {
+    fflush(stdout);
+  }
+  return(ret);
+}
+
+static int signal_stats(const struct capture_t* cap, const struct edges_t* edges) {
+  struct sigstats_t stats[SESSION_PINS_MAX];
+  double start = timing_now();
+  sigstats_compute(edges, cap, stats);
+  fprintf(stderr, "Computed signal statistics in %.3f ms\n", (timing_now() - start)*1000.0);
+
+  if(conf.signal_stats) {
+    sigstats_print(stdout, cap, stats);
+  }
+  if(conf.signal_stats_json) {
+    return(sigstats_write_json(conf.signal_stats_json, cap, stats));
+  }
+  return(EXIT_SUCCESS);
 }
 
-static int zip_add_entry(zip_t *z, char* name, void* data, size_t len) {
-  zip_source_t* src = zip_source_buffer(z, NULL, 0, 0);
-  if(!src) {
-    fprintf(stderr, "Failed to create source buffer: %s\n", zip_strerror(z));
-    zip_close(z);
+static int find_channel(const int* pins, unsigned int num_pins, int pin) {
+  for(unsigned int i = 0; i < num_pins; i++) {
+    if(pins[i] == pin) {
+      return(i);
+    }
+  }
+  return(-1);
+}
+
+// compare transitions of every pin with the golden reference, any divergence fails the run
+static int compare(const struct capture_t* cap, const struct edges_t* edges) {
+  const struct compare_ref_t* ref = &compare_ref;
+  if(fabs(cap->samp_rate - ref->samp_rate) > cap->samp_rate * 0.001) {
+    fprintf(stderr, "Sample rate %.3f MSps differs from the reference at %.3f MSps\n", cap->samp_rate/1000000.0, ref->samp_rate/1000000.0);
     return(EXIT_FAILURE);
   }
 
-  if(zip_source_begin_write(src) < 0) {
-    fprintf(stderr, "zip_source_begin_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+  // both are aligned on the trigger pin, which is the first pin given
+  int trig_pin = conf.session.num_pins ? conf.session.pins[0] : cap->pins[0];
+  int cap_ch = find_channel(cap->pins, cap->num_pins, trig_pin);
+  int ref_ch = find_channel(ref->pins, ref->num_pins, trig_pin);
+  if((cap_ch < 0) || (ref_ch < 0)) {
+    fprintf(stderr, "Trigger pin %d is not in the %s\n", trig_pin, (cap_ch < 0) ? "capture" : "reference");
     return(EXIT_FAILURE);
   }
-  
-  if(zip_source_write(src, data, len) < (zip_int64_t)len) {
-    fprintf(stderr, "zip_source_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
-    zip_source_rollback_write(src);
+  size_t cap_trig = compare_trigger(edges, cap_ch, conf.session.trig);
+  size_t ref_trig = compare_trigger(&ref->edges, ref_ch, conf.session.trig);
+  if((cap_trig == cap->num_samples) || (ref_trig == ref->edges.num_samples)) {
+    fprintf(stderr, "Trigger not found in the %s\n", (cap_trig == cap->num_samples) ? "capture" : "reference");
     return(EXIT_FAILURE);
   }
 
-  if(zip_source_commit_write(src) < 0) {
-    fprintf(stderr, "zip_source_commit_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+  struct compare_div_t* divs = malloc((conf.compare_max ? conf.compare_max : 1) * sizeof(struct compare_div_t));
+  if(!divs) {
     return(EXIT_FAILURE);
   }
 
-  if(zip_file_add(z, name, src, ZIP_FL_OVERWRITE) < 0) {
-    fprintf(stderr, "Failed to add %s: %s\n", name, zip_strerror(z));
+  fprintf(stdout, "Comparing with %s, triggered at samples %lu and %lu, jitter %u samples\n", conf.compare, cap_trig, ref_trig, conf.compare_jitter);
+  const char* kinds[] = { "level differs", "missing edge", "unexpected edge" };
+  double start = timing_now();
+  size_t total = 0;
+  for(unsigned int ch = 0; ch < cap->num_pins; ch++) {
+    ref_ch = find_channel(ref->pins, ref->num_pins, cap->pins[ch]);
+    if(ref_ch < 0) {
+      fprintf(stdout, "%s: not in the reference\n", cap->labels[ch]);
+      total++;
+      continue;
+    }
+
+    size_t num = compare_channel(edges, ch, cap_trig, &ref->edges, ref_ch, ref_trig, conf.compare_jitter, divs, conf.compare_max);
+    fprintf(stdout, "%s: %lu divergences\n", cap->labels[ch], num);
+    for(size_t i = 0; (i < num) && (i < conf.compare_max); i++) {
+      fprintf(stdout, "  %+ld samples (%+.3f us): %s\n", divs[i].pos, divs[i].pos * 1.0e6 / cap->samp_rate, kinds[divs[i].kind]);
+    }
+    total += num;
+  }
+  fprintf(stderr, "Compared in %.3f ms\n", (timing_now() - start)*1000.0);
+  fprintf(stdout, "Compare: %s\n", total ? "FAIL" : "PASS");
+
+  free(divs);
+  return(total ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+// everything that looks at the whole capture after it is done
+static int analyze(const struct capture_t* cap, const struct segment_t* view, const struct decoder_t** decoders, void** ctxs) {
+  // statistics and all decoders share a single edge index of all channels
+  double start = timing_now();
+  struct edges_t edges;
+  if(edges_build(&edges, view->samples, view->len, (cap->num_pins < 32) ? ((1UL << cap->num_pins) - 1) : UINT32_MAX) != EXIT_SUCCESS) {
     return(EXIT_FAILURE);
   }
-  
+  fprintf(stderr, "Indexed edges in %.3f ms\n", (timing_now() - start)*1000.0);
+
+  int ret = EXIT_SUCCESS;
+  if(conf.signal_stats || conf.signal_stats_json) {
+    ret = signal_stats(cap, &edges);
+  }
+  if((ret == EXIT_SUCCESS) && args.decode->count) {
+    ret = decode(view, &edges, decoders, ctxs);
+  }
+  if((ret == EXIT_SUCCESS) && conf.compare) {
+    ret = compare(cap, &edges);
+  }
+  edges_free(&edges);
+  return(ret);
+}
+
+// decoder options are checked against the captured pins, before anything is captured
+static int init_decoders(const struct capture_t* cap, const struct decoder_t** decoders, void** ctxs) {
+  for(int i = 0; i < args.decode->count; i++) {
+    const char* opts;
+    decoders[i] = decode_find(args.decode->sval[i], &opts);
+    if(!decoders[i]) {
+      fprintf(stderr, "Unknown decoder: %s\n", args.decode->sval[i]);
+      return(EXIT_FAILURE);
+    }
+    if(!(ctxs[i] = decoders[i]->init(opts, cap))) {
+      return(EXIT_FAILURE);
+    }
+  }
   return(EXIT_SUCCESS);
 }
 
-static int save_sr(size_t num_samples, char* filename, double samp_rate) {
-  int err = 0;
-  zip_error_t zip_err;
-  zip_error_init(&zip_err);
-  char workbuff[256] = { 0 };
-
-  // create filename based on current time
-  struct timespec ts;
-  timespec_get(&ts, TIME_UTC);
-  sprintf(filename, "out/pinalyzer_%lu.sr", ts.tv_sec);
-
-  // create and open the archive
-  zip_t *z = zip_open(filename, ZIP_CREATE | ZIP_TRUNCATE, &err);
-  if(!z) {
-    zip_error_init_with_code(&zip_err, err);
-    fprintf(stderr, "Cannot open zip file: %s\n", zip_error_strerror(&zip_err));
-    zip_error_fini(&zip_err);
+static void free_decoders(const struct decoder_t** decoders, void** ctxs) {
+  for(int i = 0; i < args.decode->count; i++) {
+    if(ctxs[i]) { decoders[i]->free(ctxs[i]); }
+  }
+}
+
+// give the finished output its final name, or remove it if the capture failed
+// if the name can not be used, the output is kept under the temporary one
+static int commit_output(const char* tmpname, char* filename, unsigned int seq, const struct capture_t* cap, int result) {
+  if(result != EXIT_SUCCESS) {
+    unlink(tmpname);
     return(EXIT_FAILURE);
   }
+  if(outpath_format(filename, OUTPATH_LEN_MAX, conf.out_dir, conf.out_name, conf.session.exporter->ext, seq, &cap->start, cap->trig_idx) != EXIT_SUCCESS) {
+    strcpy(filename, tmpname);
+    return(EXIT_FAILURE);
+  }
+  return(outpath_commit(tmpname, filename));
+}
 
-  // add the metadata file
-  int written = sprintf(workbuff, SIGROK_FILE_METADATA, conf.num_pins, samp_rate);
-  char* buff_ptr = &workbuff[written];
-  for(unsigned int i = 0; i < conf.num_pins; i++) {
-    if((unsigned int)args.labels->count >= (i + 1)) {
-      written = sprintf(buff_ptr, "probe%d=%s\n", (i + 1), args.labels->sval[i]);
-    } else {
-      written = sprintf(buff_ptr, "probe%d=BCM%d\n", (i + 1), conf.pins[i]);
-    }
-    buff_ptr += written;
+static int run() {
+  // the final name depends on the capture, until then the output is written under a temporary one
+  char tmpname[OUTPATH_LEN_MAX];
+  char filename[OUTPATH_LEN_MAX];
+  if(outpath_temp(tmpname, sizeof(tmpname), conf.out_dir, 0, conf.session.exporter->ext) != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
   }
-  zip_add_entry(z, "metadata", workbuff, strlen(workbuff));
+  strcpy(filename, tmpname);
+  conf.session.filename = tmpname;
 
-  // add the version file (yes, it is just a single number)
-  sprintf(workbuff, "2");
-  zip_add_entry(z, "version", workbuff, strlen(workbuff));
+  // everything is allocated and the output opened before waiting for the trigger
+  struct session_t* s = session_open();
+  if(!s) {
+    return(EXIT_FAILURE);
+  }
+  if(session_configure(s, &conf.session) != EXIT_SUCCESS) {
+    session_close(s);
+    return(EXIT_FAILURE);
+  }
 
-  // now add all the samples
-  zip_source_t* src = zip_source_buffer(z, NULL, 0, 0);
-  if(!src) {
-    fprintf(stderr, "Failed to create source buffer: %s\n", zip_strerror(z));
-    zip_close(z);
+  const struct decoder_t* decoders[DECODERS_MAX];
+  void* decoder_ctxs[DECODERS_MAX] = { NULL };
+  int ret = init_decoders(session_get_capture(s), decoders, decoder_ctxs);
+  if(ret == EXIT_SUCCESS) {
+    ret = session_arm(s);
+  }
+  if(ret != EXIT_SUCCESS) {
+    free_decoders(decoders, decoder_ctxs);
+    session_close(s);
+    unlink(tmpname);
     return(EXIT_FAILURE);
   }
 
-  if(zip_source_begin_write(src) < 0) {
-    fprintf(stderr, "zip_source_begin_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+  ret = session_wait(s);
+  const struct capture_t* cap = session_get_capture(s);
+  ret = commit_output(tmpname, filename, 0, cap, ret);
+  if(ret == EXIT_SUCCESS) {
+    fprintf(stdout, "%lu samples saved to %s\n", cap->num_samples, filename);
+    fprintf(stdout, "Sampling rate %.3f MSps\n", cap->samp_rate/1000000.0);
+  } else {
+    fprintf(stderr, "Failed to save %lu samples to %s\n", cap->num_samples, filename);
+  }
+  print_pipeline_stats();
+
+  if(conf.stats_json) {
+    struct pipeline_stats_t stats;
+    pipeline_get_stats(&stats);
+    struct stat st;
+    struct timing_report_t report = {
+      .cap = cap,
+      .format = conf.session.exporter->name,
+      .filename = filename,
+      .result = ret,
+      .bytes_raw = cap->num_samples * ((cap->num_pins + 7) / 8),
+      .bytes_written = (stat(filename, &st) == 0) ? (uint64_t)st.st_size : 0,
+      .pipeline = &stats,
+    };
+    if(timing_write_json(conf.stats_json, &report) != EXIT_SUCCESS) {
+      ret = EXIT_FAILURE;
+    }
+  }
+
+  struct segment_t view;
+  if((ret == EXIT_SUCCESS) && conf.session.keep_samples) {
+    ret = session_read_samples(s, 0, cap->num_samples, &view);
+    if(ret == EXIT_SUCCESS) {
+      ret = analyze(cap, &view, decoders, decoder_ctxs);
+    }
+  }
+  free_decoders(decoders, decoder_ctxs);
+
+  session_close(s);
+  return(ret);
+}
+
+// keep re-arming, every capture is handed over to a background writer so that the next one can be armed right away
+static int run_monitor() {
+  // the session only keeps the samples in memory, files are written by the monitor
+  struct session_conf_t session_conf = conf.session;
+  session_conf.exporter = NULL;
+  session_conf.filename = NULL;
+  session_conf.keep_samples = false;
+  struct session_t* s = session_open();
+  if(!s) {
     return(EXIT_FAILURE);
   }
-  
-  // convert all samples to sigrok binary format
-  int sample_width = (conf.num_pins + 7) / 8;
-  for(size_t i = 0; i < num_samples; i++) {
-    uint32_t sample = *(uint32_t*)dma_get_samp_ptr(i);
-    uint32_t val = 0;
-    for(unsigned int j = 0; j < conf.num_pins; j++) {
-      val |= (((sample & (1UL << conf.pins[j])) != 0) << j);
+  conf.monitor_conf.exporter = conf.session.exporter;
+  conf.monitor_conf.export_opts = conf.session.export_opts;
+  if((session_configure(s, &session_conf) != EXIT_SUCCESS) || (monitor_start(&conf.monitor_conf, session_get_capture(s)) != EXIT_SUCCESS)) {
+    monitor_stop();
+    session_close(s);
+    return(EXIT_FAILURE);
+  }
+
+  // dead time is from the end of one capture until the next one is armed
+  int ret = EXIT_SUCCESS;
+  double end = 0;
+  double dead_min = 0, dead_max = 0, dead_sum = 0;
+  unsigned int num = 0;
+  for(; (conf.monitor_count == 0) || (num < conf.monitor_count); num++) {
+    if((ret = session_arm(s)) != EXIT_SUCCESS) {
+      break;
     }
-    workbuff[0] = val & 0x000000FFUL;
-    workbuff[1] = (val & 0x0000FF00UL) >> 8;
-    workbuff[2] = (val & 0x00FF0000UL) >> 16;
-    workbuff[3] = (val & 0xFF000000UL) >> 24;
-
-    // this seems very inefficient, but this operation happens entirely in memory, so it is fine
-    if(zip_source_write(src, workbuff, sample_width) < (zip_int64_t)sample_width) {
-      fprintf(stderr, "zip_source_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
-      zip_source_rollback_write(src);
-      return(EXIT_FAILURE);
+    if(num > 0) {
+      double dead = timing_now() - end;
+      if((num == 1) || (dead < dead_min)) { dead_min = dead; }
+      if(dead > dead_max) { dead_max = dead; }
+      dead_sum += dead;
+      fprintf(stdout, "Capture %u armed, dead time %.3f ms\n", num + 1, dead*1000.0);
+    }
+
+    ret = session_wait(s);
+    end = timing_now();
+    const struct capture_t* cap = session_get_capture(s);
+    struct segment_t view;
+    if((ret != EXIT_SUCCESS) || ((ret = session_read_samples(s, 0, cap->num_samples, &view)) != EXIT_SUCCESS)) {
+      break;
+    }
+
+    char tmpname[OUTPATH_LEN_MAX];
+    char filename[OUTPATH_LEN_MAX];
+    const char* ext = conf.session.exporter->ext;
+    if(((ret = outpath_temp(tmpname, sizeof(tmpname), conf.out_dir, num, ext)) != EXIT_SUCCESS) ||
+      ((ret = outpath_format(filename, sizeof(filename), conf.out_dir, conf.out_name, ext, num, &cap->start, cap->trig_idx)) != EXIT_SUCCESS) ||
+      ((ret = monitor_submit(cap, view.samples, tmpname, filename)) != EXIT_SUCCESS)) {
+      break;
     }
   }
 
-  if(zip_source_commit_write(src) < 0) {
-    fprintf(stderr, "zip_source_commit_write failed: %s\n", zip_error_strerror(zip_source_error(src)));
+  if(monitor_stop() != EXIT_SUCCESS) {
+    ret = EXIT_FAILURE;
+  }
+  struct monitor_stats_t stats;
+  monitor_get_stats(&stats);
+  fprintf(stdout, "Monitor: %u captures, %u files written (%lu bytes), %u old files deleted, writer busy %.3f s, waited for writer %.3f s\n",
+    num, stats.files, stats.bytes, stats.deleted, stats.write_time, stats.wait_time);
+  if(num > 1) {
+    fprintf(stdout, "Dead time min %.3f ms, mean %.3f ms, max %.3f ms\n", dead_min*1000.0, dead_sum*1000.0/(num - 1), dead_max*1000.0);
+  }
+
+  session_close(s);
+  return(ret);
+}
+
+// stream samples of an existing sigrok session file through the same trigger, output and analysis as a capture
+static int replay(const char* path) {
+  struct capture_t cap;
+  struct replay_t* r = replay_open(path, &cap);
+  if(!r) {
     return(EXIT_FAILURE);
   }
+  fprintf(stdout, "Replaying %lu samples of %u channels at %.3f MSps from %s\n", cap.num_samples, cap.num_pins, cap.samp_rate/1000000.0, path);
+
+  // trigger source is the first pin given, or the first channel
+  unsigned int trig_ch = 0;
+  if(conf.session.num_pins) {
+    while((trig_ch < cap.num_pins) && (cap.pins[trig_ch] != conf.session.pins[0])) { trig_ch++; }
+    if(trig_ch == cap.num_pins) {
+      fprintf(stderr, "Trigger pin %d is not in the file\n", conf.session.pins[0]);
+      replay_close(r);
+      return(EXIT_FAILURE);
+    }
+  }
 
-  // dump everything into the same file
-  if(zip_file_add(z, "logic-1", src, ZIP_FL_OVERWRITE) < 0) {
-    fprintf(stderr, "Failed to add samples: %s\n", zip_strerror(z));
+  // output is only written when a format was given, samples are decompressed into a single segment
+  const struct exporter_t* exporter = args.format->count ? conf.session.exporter : NULL;
+  size_t bytes = PIPELINE_SEGMENT_SAMPLES * sizeof(uint32_t) + REPLAY_ARENA_SLACK;
+  if(exporter) { bytes += exporter->mem_size(&cap, &conf.session.export_opts); }
+  if(conf.session.keep_samples) { bytes += exporter_mem.mem_size(&cap, &conf.session.export_opts); }
+  if(arena_init(bytes) != EXIT_SUCCESS) {
+    replay_close(r);
     return(EXIT_FAILURE);
   }
 
-  // all done, close the archive
-  if(zip_close(z) < 0) {
-    fprintf(stderr, "Failed to close zip archive: %s\n", zip_strerror(z));
+  const struct decoder_t* decoders[DECODERS_MAX];
+  void* decoder_ctxs[DECODERS_MAX] = { NULL };
+  char tmpname[OUTPATH_LEN_MAX];
+  char filename[OUTPATH_LEN_MAX];
+  if(exporter && (outpath_temp(tmpname, sizeof(tmpname), conf.out_dir, 0, exporter->ext) != EXIT_SUCCESS)) {
+    replay_close(r);
+    arena_free();
     return(EXIT_FAILURE);
   }
+  uint32_t* samples = arena_alloc(PIPELINE_SEGMENT_SAMPLES * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+  void* ctx = NULL;
+  void* mem_ctx = NULL;
+  int ret = init_decoders(&cap, decoders, decoder_ctxs);
+  if((ret == EXIT_SUCCESS) && (!samples ||
+    (exporter && !(ctx = exporter->open(tmpname, &cap, &conf.session.export_opts))) ||
+    (conf.session.keep_samples && !(mem_ctx = exporter_mem.open(NULL, &cap, &conf.session.export_opts))))) {
+    ret = EXIT_FAILURE;
+  }
 
-  return(EXIT_SUCCESS);
-}
+  // the trigger may be on the boundary of two segments
+  double start = timing_now();
+  timespec_get(&cap.start, TIME_UTC);
+  size_t offset = 0;
+  size_t trig_idx = SIZE_MAX;
+  uint32_t prev = 0;
+  while(ret == EXIT_SUCCESS) {
+    long len = replay_read(r, samples, PIPELINE_SEGMENT_SAMPLES);
+    if(len <= 0) {
+      ret = (len < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+      break;
+    }
 
-static int run() {
-  if(conf.trig != TRIG_TYPE_IMMEDIATE) {
-    fprintf(stdout, "Waiting for trigger\n");
-    wait_for_trigger();
-  }
+    if(trig_idx == SIZE_MAX) {
+      size_t idx = trigger_scan(samples, len, trig_ch, conf.session.trig);
+      if((offset > 0) && trigger_edge(conf.session.trig, (prev >> trig_ch) & 1, (samples[0] >> trig_ch) & 1)) {
+        idx = 0;
+      }
+      if(idx < (size_t)len) {
+        trig_idx = offset + idx;
+      }
+      prev = samples[len - 1];
+    }
 
-  dma_start();
-  fprintf(stdout, "Running capture\n");
+    struct segment_t seg = { .samples = samples, .offset = offset, .len = len };
+    if((exporter && (exporter->write(ctx, &seg) != EXIT_SUCCESS)) || (mem_ctx && (exporter_mem.write(mem_ctx, &seg) != EXIT_SUCCESS))) {
+      ret = EXIT_FAILURE;
+    }
+    offset += len;
+  }
+  timespec_get(&cap.end, TIME_UTC);
 
-  // wait until the DMA is done (1ms more than the capture length)
-  usleep((conf.capture_len + 1)*1000UL);
+  // trigger index is only needed when closing the output
+  cap.num_samples = offset;
+  cap.trig_idx = (trig_idx == SIZE_MAX) ? 0 : trig_idx;
+  if(ctx && (exporter->close(ctx) != EXIT_SUCCESS)) {
+    ret = EXIT_FAILURE;
+  }
+  if(exporter) {
+    ret = commit_output(tmpname, filename, 0, &cap, ret);
+  }
 
-  // convert to sample rate in Msps
-  double samp_rate = ((double)conf.num_samples/conf.capture_len)/1000.0;
-  char filename[64];
-  int ret = save_sr(conf.num_samples, filename, samp_rate);
+  double elapsed = timing_now() - start;
   if(ret == EXIT_SUCCESS) {
-    fprintf(stdout, "%lu samples saved to %s\n", conf.num_samples, filename);
-    fprintf(stdout, "Sampling rate %.3f MSps\n", samp_rate);
-  } else {
-    fprintf(stderr, "Failed to save %lu samples to %s\n", conf.num_samples, filename);
+    fprintf(stdout, "Replayed %lu samples in %.3f ms (%.3f MSps)\n", offset, elapsed*1000.0, (elapsed > 0) ? offset/elapsed/1000000.0 : 0);
+    if(ctx) {
+      fprintf(stdout, "%lu samples saved to %s\n", offset, filename);
+    }
+    if(trig_idx == SIZE_MAX) {
+      fprintf(stderr, "Trigger not found in %lu samples\n", offset);
+      ret = EXIT_FAILURE;
+    } else {
+      fprintf(stdout, "Triggered at sample %lu\n", trig_idx);
+    }
   }
 
+  if((ret == EXIT_SUCCESS) && mem_ctx) {
+    struct segment_t view = { .samples = export_mem_samples(mem_ctx), .offset = 0, .len = offset };
+    ret = analyze(&cap, &view, decoders, decoder_ctxs);
+  }
+  free_decoders(decoders, decoder_ctxs);
+  arena_free();
+
+  // pins and labels of the capture belong to the reader
+  replay_close(r);
   return(ret);
 }
 
 int main(int argc, char** argv) {
   void *argtable[] = {
-    args.pins = arg_intn("p", "pins", NULL, 1, PINS_MAX, "BCMx pins to capture, maximum of " STR(PINS_MAX) ". The first pin will be used as trigger source."),
-    args.sample_rate = arg_int0("s", "sample_rate", "Sps", "Sample rate, defaults to " STR(SAMPLE_RATE_DEFAULT) " maximum of " STR(SAMPLE_RATE_MAX) ". "\
-      "If set to more than " STR(SAMPLE_RATE_NO_THROTTLE) ", then the maximum possible sa sampling rate control above this value is very unreliable."),
+    args.pins = arg_intn("p", "pins", NULL, 0, SESSION_PINS_MAX, "BCMx pins to capture (0 - " STR(SESSION_GPIO_PIN_MAX) "), maximum of " STR(SESSION_PINS_MAX) ". The first pin will be used as trigger source."),
+    args.sample_rate = arg_int0("s", "sample_rate", "Sps", "Sample rate, defaults to the maximum for the detected board, at most " STR(SESSION_RATE_MAX) ". "\
+      "If set to more than " STR(SESSION_RATE_NO_THROTTLE) ", then the maximum possible sa sampling rate control above this value is very unreliable."),
     args.capture_len = arg_int0("l", "capture_len", "ms", "Capture length, defaults to 100 milliseconds"),
     args.trig_type = arg_str0("t", "trigger", NULL, "Trigger type: r/rising, f/falling, a/any, i/immediate, defaults to rising"),
-    args.labels = arg_strn("n", "names", NULL, 0, PINS_MAX, "Signal names for labeling the output, in the order provided pin numbers"),
+    args.labels = arg_strn("n", "names", NULL, 0, SESSION_PINS_MAX, "Signal names for labeling the output, in the order provided pin numbers"),
+    args.format = arg_str0("f", "format", NULL, "Output format: sr (sigrok session), vcd (value change dump) or raw (memory-mappable binary), defaults to sr"),
+    args.io_uring = arg_lit0(NULL, "io-uring", "Write output asynchronously using io_uring (raw format only)"),
+    args.direct = arg_lit0(NULL, "direct", "Bypass the page cache when writing with io_uring (O_DIRECT)"),
+    args.summary = arg_lit0(NULL, "summary", "Store a min/max summary pyramid for fast zooming next to the samples (sr and raw formats)"),
+    args.sim = arg_file0(NULL, "sim", "<file>", "Run on simulated hardware, with input waveforms described by the script file"),
+    args.stats_json = arg_file0(NULL, "stats-json", "<file>", "Write timing of all phases and capture statistics as JSON to file, - for stdout"),
+    args.dma_priority = arg_int0(NULL, "dma-priority", "0-15", "AXI priority of DMA transfers, defaults to 8"),
+    args.dma_panic_priority = arg_int0(NULL, "dma-panic-priority", "0-15", "AXI priority of DMA transfers in panic, defaults to 8"),
+    args.no_wait_resp = arg_lit0(NULL, "no-wait-resp", "Do not wait for write response after each sample"),
+    args.probe_rate = arg_lit0(NULL, "probe-rate", "Measure the achievable sample rate with different DMA settings and exit"),
+    args.replay = arg_file0(NULL, "replay", "<file.sr>", "Run trigger, signal statistics, decoders and output (only with --format) over an existing sigrok session file instead of capturing"),
+    args.monitor = arg_int0(NULL, "monitor", "N", "Keep re-arming the trigger and write every capture to a new file in the background, stop after N captures or never with 0"),
+    args.max_files = arg_int0(NULL, "max-files", "N", "In monitor mode, delete the oldest files to keep at most N of them"),
+    args.max_mbytes = arg_int0(NULL, "max-mbytes", "MiB", "In monitor mode, delete the oldest files to keep their total size below this"),
+    args.out_dir = arg_str0(NULL, "out-dir", "<dir>", "Directory for the output files, created if it does not exist, defaults to " OUTPATH_DIR_DEFAULT),
+    args.out_name = arg_str0(NULL, "out-name", "<template>", "Output file name, {seq}, {sec}, {nsec}, {trig} and {ext} are replaced by the sequence number, "\
+      "capture start in seconds and nanoseconds, trigger sample index and format extension, defaults to " OUTPATH_TEMPLATE_DEFAULT),
+    args.dt_root = arg_file0(NULL, "dt-root", "<dir>", "Detect the board from copies of device tree files in directory instead of /proc/device-tree"),
+    args.decode = arg_strn(NULL, "decode", "<proto:opts>", 0, DECODERS_MAX, "Decode protocol after the capture, e.g. spi:clk=17,mosi=22,miso=27,cs=4,mode=0"),
+    args.decode_out = arg_file0(NULL, "decode-out", "<file>", "Write decoded records to file, defaults to - for stdout"),
+    args.decode_format = arg_str0(NULL, "decode-format", NULL, "Format of decoded records: csv or bin, defaults to csv"),
+    args.signal_stats = arg_lit0(NULL, "signal-stats", "Print edge count, pulse widths, frequency, duty cycle and longest idle time of every pin after the capture"),
+    args.signal_stats_json = arg_file0(NULL, "signal-stats-json", "<file>", "Write the signal statistics as JSON to file, - for stdout"),
+    args.compare = arg_file0(NULL, "compare", "<file.sr>", "Compare transitions of all pins with a golden reference capture after aligning both on the trigger, exit with failure if they differ"),
+    args.compare_jitter = arg_int0(NULL, "compare-jitter", "samples", "Maximum distance of matching edges in the comparison, defaults to " STR(COMPARE_JITTER_DEFAULT)),
+    args.compare_max = arg_int0(NULL, "compare-max", "N", "Number of divergences listed for each pin, defaults to " STR(COMPARE_MAX_DEFAULT)),
     args.help = arg_lit0(NULL, "help", "Display this help and exit"),
     args.end = arg_end(3),
   };
@@ -306,33 +673,70 @@ int main(int argc, char** argv) {
   atexit(exithandler);
   signal(SIGINT, sighandler);
 
-  // parse pins
-  if((args.pins->count < 1) || (args.pins->count > PINS_MAX)) {
-    fprintf(stderr, "Invalid number of capture pins: %d\n", args.pins->count);
+  // parse DMA settings
+  if(args.dma_priority->count) { conf.session.dma_opts.priority = args.dma_priority->ival[0]; }
+  if(args.dma_panic_priority->count) { conf.session.dma_opts.panic_priority = args.dma_panic_priority->ival[0]; }
+  conf.session.dma_opts.wait_resp = (args.no_wait_resp->count == 0);
+  if((conf.session.dma_opts.priority > 15) || (conf.session.dma_opts.panic_priority > 15)) {
+    fprintf(stderr, "Invalid DMA priority, must be 0 - 15\n");
+    exitcode = EXIT_FAILURE;
+    goto exit;
+  }
+
+  // everything below depends on the board, except for replay
+  if(!args.replay->count && init_board(args.dt_root->count ? args.dt_root->filename[0] : NULL, args.sim->count > 0) != EXIT_SUCCESS) {
     exitcode = EXIT_FAILURE;
     goto exit;
   }
 
-  conf.num_pins = args.pins->count;
-  for(unsigned int i = 0; i < conf.num_pins; i++) {
-    conf.pins[i] = args.pins->ival[i];
+  // rate probing does not need anything else
+  if(args.probe_rate->count) {
+    if(args.sim->count && (hal_use_sim(args.sim->filename[0]) != 0)) {
+      exitcode = EXIT_FAILURE;
+      goto exit;
+    }
+    struct probe_result_t best;
+    exitcode = probe_rate(PROBE_SAMPLES, PROBE_RUNS, &best);
+    goto exit;
   }
 
+  // parse pins, these are checked when the session is configured
+  conf.session.pins = args.pins->ival;
+  conf.session.num_pins = args.pins->count;
+  for(int i = 0; i < args.labels->count; i++) {
+    conf.labels[i] = args.labels->sval[i];
+  }
+  conf.session.labels = conf.labels;
+
+  // parse the output format
+  if(args.format->count) {
+    conf.session.exporter = export_find(args.format->sval[0]);
+    if(!conf.session.exporter) {
+      fprintf(stderr, "Unknown output format: %s\n", args.format->sval[0]);
+      exitcode = EXIT_FAILURE;
+      goto exit;
+    }
+  }
+
+  conf.session.export_opts.async = (args.io_uring->count > 0);
+  conf.session.export_opts.direct = (args.direct->count > 0);
+  conf.session.export_opts.summary = (args.summary->count > 0);
+
   // parse the trigger type
   if(args.trig_type->count) {
     if(strlen(args.trig_type->sval[0]) == 1) {
       switch(args.trig_type->sval[0][0]) {
         case 'r':
-          conf.trig = TRIG_TYPE_RISING;
+          conf.session.trig = TRIG_TYPE_RISING;
           break;
         case 'f':
-          conf.trig = TRIG_TYPE_FALLING;
+          conf.session.trig = TRIG_TYPE_FALLING;
           break;
         case 'a':
-          conf.trig = TRIG_TYPE_ANY;
+          conf.session.trig = TRIG_TYPE_ANY;
           break;
         case 'i':
-          conf.trig = TRIG_TYPE_IMMEDIATE;
+          conf.session.trig = TRIG_TYPE_IMMEDIATE;
           break;
         default:
           fprintf(stderr, "Uknown trigger type: %c\n", args.trig_type->sval[0][0]);
@@ -341,13 +745,13 @@ int main(int argc, char** argv) {
       }
     } else {
       if(strcmp(args.trig_type->sval[0], "rising") == 0) {
-        conf.trig = TRIG_TYPE_RISING;
+        conf.session.trig = TRIG_TYPE_RISING;
       } else if(strcmp(args.trig_type->sval[0], "falling") == 0) {
-        conf.trig = TRIG_TYPE_FALLING;
+        conf.session.trig = TRIG_TYPE_FALLING;
       } else if(strcmp(args.trig_type->sval[0], "any") == 0) {
-        conf.trig = TRIG_TYPE_ANY;
+        conf.session.trig = TRIG_TYPE_ANY;
       } else if(strcmp(args.trig_type->sval[0], "immediate") == 0) {
-        conf.trig = TRIG_TYPE_IMMEDIATE;
+        conf.session.trig = TRIG_TYPE_IMMEDIATE;
       } else {
         fprintf(stderr, "Uknown trigger type: %s\n", args.trig_type->sval[0]);
         exitcode = EXIT_FAILURE;
@@ -356,34 +760,91 @@ int main(int argc, char** argv) {
     }
   }
 
-  // initialize GPIO
-  // TODO this is currently only used for the trigger, rework that to also use DMA
-  int fd = open("/dev/gpiomem", O_RDWR | O_SYNC);
-  if(fd < 0) {
-    fprintf(stderr, "Failed to open GPIO device!\n");
+  if(args.stats_json->count) { conf.stats_json = args.stats_json->filename[0]; }
+
+  // decoders and signal statistics need the whole capture in memory
+  conf.signal_stats = (args.signal_stats->count > 0);
+  if(args.signal_stats_json->count) { conf.signal_stats_json = args.signal_stats_json->filename[0]; }
+  if(args.compare->count) { conf.compare = args.compare->filename[0]; }
+  if((args.compare_jitter->count && (args.compare_jitter->ival[0] < 0)) || (args.compare_max->count && (args.compare_max->ival[0] < 0))) {
+    fprintf(stderr, "Invalid comparison jitter or number of reported divergences, must not be negative\n");
+    exitcode = EXIT_FAILURE;
+    goto exit;
+  }
+  if(args.compare_jitter->count) { conf.compare_jitter = args.compare_jitter->ival[0]; }
+  if(args.compare_max->count) { conf.compare_max = args.compare_max->ival[0]; }
+  conf.session.keep_samples = (args.decode->count > 0) || conf.signal_stats || conf.signal_stats_json || conf.compare;
+  if(args.decode_out->count) { conf.decode_out = args.decode_out->filename[0]; }
+  if(args.decode_format->count) {
+    if(strcmp(args.decode_format->sval[0], "csv") == 0) {
+      conf.decode_fmt = DECODE_FMT_CSV;
+    } else if(strcmp(args.decode_format->sval[0], "bin") == 0) {
+      conf.decode_fmt = DECODE_FMT_BIN;
+    } else {
+      fprintf(stderr, "Unknown decode format: %s\n", args.decode_format->sval[0]);
+      exitcode = EXIT_FAILURE;
+      goto exit;
+    }
+  }
+
+  // monitor mode only writes files
+  if(args.monitor->count) {
+    if((args.monitor->ival[0] < 0) || (args.max_files->count && (args.max_files->ival[0] < 0)) ||
+      (args.max_mbytes->count && (args.max_mbytes->ival[0] < 0))) {
+      fprintf(stderr, "Invalid number of captures, files or MiB for monitor mode, must not be negative\n");
+      exitcode = EXIT_FAILURE;
+      goto exit;
+    }
+    conf.monitor = true;
+    conf.monitor_count = args.monitor->ival[0];
+    if(args.max_files->count) { conf.monitor_conf.max_files = args.max_files->ival[0]; }
+    if(args.max_mbytes->count) { conf.monitor_conf.max_bytes = (uint64_t)args.max_mbytes->ival[0] * 1024UL * 1024UL; }
+    if(conf.session.keep_samples || args.replay->count || conf.stats_json) {
+      fprintf(stderr, "Monitor mode can not be combined with replay, decoders, statistics or comparison\n");
+      exitcode = EXIT_FAILURE;
+      goto exit;
+    }
+  }
+
+  // output names are checked and the directory created before anything is captured
+  if(args.out_dir->count) { conf.out_dir = args.out_dir->sval[0]; }
+  if(args.out_name->count) { conf.out_name = args.out_name->sval[0]; }
+  if(!args.replay->count || args.format->count) {
+    if((outpath_check(conf.out_dir, conf.out_name) != EXIT_SUCCESS) || (outpath_mkdir(conf.out_dir) != EXIT_SUCCESS)) {
+      exitcode = EXIT_FAILURE;
+      goto exit;
+    }
+  }
+
+  // reference is loaded up front, so that a bad file does not waste a capture
+  if(conf.compare && (compare_load(conf.compare, &compare_ref) != EXIT_SUCCESS)) {
+    fprintf(stderr, "Failed to load reference %s\n", conf.compare);
     exitcode = EXIT_FAILURE;
     goto exit;
   }
 
-  // access GPIO via memory mapping
-  gpio = (uint32_t *)mmap(0, 4*1024, PROT_READ | PROT_WRITE, MAP_SHARED, fd, PERIPH_ADDR(GPIO_BASE));
-  close(fd);
-  if(gpio == MAP_FAILED) {
-    fprintf(stderr, "Failed to map GPIO device!\n");
+  // replay needs neither the board nor the DMA
+  if(args.replay->count) {
+    exitcode = replay(args.replay->filename[0]);
+    goto exit;
+  }
+
+  // select the simulated backend, if requested
+  if(args.sim->count && (hal_use_sim(args.sim->filename[0]) != 0)) {
     exitcode = EXIT_FAILURE;
     goto exit;
   }
-  
-  // intialize the DMA
-  const size_t rate = args.sample_rate->count ? args.sample_rate->ival[0] : SAMPLE_RATE_DEFAULT;
+
+  // capture length is converted to samples at the requested rate
+  conf.session.rate = args.sample_rate->count ? (unsigned int)args.sample_rate->ival[0] : board_get()->rate_default;
   if(args.capture_len->count) { conf.capture_len = args.capture_len->ival[0]; }
-  conf.num_samples = (rate / 1000) * conf.capture_len;
-  dma_init(conf.num_samples, (rate >= SAMPLE_RATE_NO_THROTTLE) ? 0 : rate);
+  conf.session.num_samples = ((uint64_t)conf.session.rate * conf.capture_len) / 1000;
 
   // run the capture
-  exitcode = run();
+  exitcode = conf.monitor ? run_monitor() : run();
 
 exit:
+  compare_free(&compare_ref);
   arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
 
   return(exitcode);
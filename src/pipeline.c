@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "dma/dma.h"
+
+#include "pipeline.h"
+#include "convert.h"
+#include "spsc.h"
+#include "arena.h"
+#include "timing.h"
+
+// how long to sleep when there is nothing to do
+#define PIPELINE_POLL_US            (100)
+
+// abort the capture if DMA makes no progress for this long
+#define PIPELINE_DMA_TIMEOUT_US     (1000000UL)
+
+struct pipeline_seg_t {
+  // raw samples are one or two words each, depending on the number of sampled GPIO banks
+  uint32_t* raw;
+  uint32_t samples[PIPELINE_SEGMENT_SAMPLES];
+  size_t offset;
+  size_t len;
+};
+
+static struct pipeline_t {
+  struct pipeline_seg_t* segs;
+
+  // free -> drain -> convert -> output -> free
+  struct spsc_t q_free;
+  struct spsc_t q_convert;
+  struct spsc_t q_output;
+  void* q_free_slots[PIPELINE_NUM_SEGMENTS];
+  void* q_convert_slots[PIPELINE_NUM_SEGMENTS];
+  void* q_output_slots[PIPELINE_NUM_SEGMENTS];
+
+  // current run
+  struct capture_t* cap;
+  const struct exporter_t* exporter;
+  void* ctx;
+  atomic_bool abort;
+  int ret_drain;
+  int ret_output;
+
+  struct pipeline_stats_t stats;
+} pl = {
+  .segs = NULL,
+};
+
+static void pipeline_fail(int* ret) {
+  *ret = EXIT_FAILURE;
+  atomic_store(&pl.abort, true);
+}
+
+static bool pipeline_aborted() {
+  return(atomic_load_explicit(&pl.abort, memory_order_relaxed));
+}
+
+// pass segment to the next stage, the queues can hold all segments so this can not really block
+static void pipeline_push(struct spsc_t* q, struct pipeline_seg_t* seg, struct pipeline_stage_stats_t* stats) {
+  while(!spsc_push(q, seg)) {
+    if(pipeline_aborted()) {
+      return;
+    }
+    stats->stalls_out++;
+    usleep(PIPELINE_POLL_US);
+  }
+}
+
+// get segment from the previous stage, returns false on abort
+static bool pipeline_pop(struct spsc_t* q, struct pipeline_seg_t** seg, struct pipeline_stage_stats_t* stats) {
+  while(!spsc_pop(q, (void**)seg)) {
+    if(pipeline_aborted()) {
+      return(false);
+    }
+    stats->stalls_in++;
+    usleep(PIPELINE_POLL_US);
+  }
+  return(true);
+}
+
+static void* pipeline_drain(void* arg) {
+  (void)arg;
+  struct pipeline_stage_stats_t* stats = &pl.stats.stages[PIPELINE_STAGE_DRAIN];
+  size_t num_samples = pl.cap->num_samples;
+  size_t buff_len = dma_get_buff_len();
+  size_t words = dma_get_sample_words();
+  size_t progress = 0;
+  unsigned long idle_us = 0;
+
+  for(size_t offset = 0; (offset < num_samples) && !pipeline_aborted(); ) {
+    // wait for a free segment, if there is none the later stages are falling behind
+    // in a ring, the DMA may come around to the samples not drained yet in the meantime
+    struct pipeline_seg_t* seg;
+    bool overrun = false;
+    while(!spsc_pop(&pl.q_free, (void**)&seg)) {
+      if(pipeline_aborted()) {
+        return(NULL);
+      }
+      if((buff_len < num_samples) && (dma_get_progress() >= offset + buff_len)) {
+        overrun = true;
+        break;
+      }
+      stats->stalls_out++;
+      usleep(PIPELINE_POLL_US);
+    }
+    if(overrun) {
+      fprintf(stderr, "DMA buffer overrun at sample %lu of %lu\n", offset, num_samples);
+      pipeline_fail(&pl.ret_drain);
+      break;
+    }
+
+    // copy samples out as soon as DMA gets to them, the DMA buffer may be a ring shorter than a segment
+    seg->offset = offset;
+    seg->len = num_samples - offset;
+    if(seg->len > PIPELINE_SEGMENT_SAMPLES) { seg->len = PIPELINE_SEGMENT_SAMPLES; }
+    size_t copied = 0;
+    while((copied < seg->len) && !pipeline_aborted()) {
+      size_t curr = dma_get_progress();
+      if(curr != progress) {
+        progress = curr;
+        idle_us = 0;
+
+        // for the drain stage, occupancy is the number of segments captured but not yet drained
+        size_t backlog = (progress - offset) / PIPELINE_SEGMENT_SAMPLES;
+        if(backlog > stats->occupancy_max) { stats->occupancy_max = backlog; }
+      }
+
+      size_t pos = offset + copied;
+      size_t end = (progress < offset + seg->len) ? progress : offset + seg->len;
+      if(end <= pos) {
+        if(dma_failed()) {
+          fprintf(stderr, "DMA error at sample %lu of %lu\n", progress, num_samples);
+          pipeline_fail(&pl.ret_drain);
+          break;
+        }
+        if(idle_us >= PIPELINE_DMA_TIMEOUT_US) {
+          fprintf(stderr, "DMA stalled at sample %lu of %lu\n", progress, num_samples);
+          pipeline_fail(&pl.ret_drain);
+          break;
+        }
+        stats->stalls_in++;
+        usleep(PIPELINE_POLL_US);
+        idle_us += PIPELINE_POLL_US;
+        continue;
+      }
+
+      // copy up to the end of the buffer, the rest will go in the next round
+      size_t len = end - pos;
+      size_t head = buff_len - (pos % buff_len);
+      if(len > head) { len = head; }
+      double start = timing_now();
+      memcpy(&seg->raw[copied * words], dma_get_samp_ptr(pos), len * words * sizeof(uint32_t));
+      stats->busy += timing_now() - start;
+
+      // in a ring, DMA must not have come around to the copied samples in the meantime
+      if((buff_len < num_samples) && (dma_get_progress() >= pos + buff_len)) {
+        fprintf(stderr, "DMA buffer overrun at sample %lu of %lu\n", pos, num_samples);
+        pipeline_fail(&pl.ret_drain);
+        break;
+      }
+      copied += len;
+    }
+
+    if(pipeline_aborted()) {
+      break;
+    }
+
+    offset += seg->len;
+    stats->segments++;
+    pipeline_push(&pl.q_convert, seg, stats);
+  }
+
+  timespec_get(&pl.cap->end, TIME_UTC);
+
+  // signal the end of capture
+  pipeline_push(&pl.q_convert, NULL, stats);
+  return(NULL);
+}
+
+static void* pipeline_convert(void* arg) {
+  (void)arg;
+  struct pipeline_stage_stats_t* stats = &pl.stats.stages[PIPELINE_STAGE_CONVERT];
+  struct pipeline_seg_t* seg;
+  while(pipeline_pop(&pl.q_convert, &seg, stats)) {
+    if(!seg) {
+      break;
+    }
+
+    double start = timing_now();
+    if(dma_get_sample_words() > 1) {
+      convert_samples_wide(seg->raw, seg->samples, seg->len, pl.cap->pins, pl.cap->num_pins);
+    } else {
+      convert_samples(seg->raw, seg->samples, seg->len, pl.cap->pins, pl.cap->num_pins);
+    }
+    stats->busy += timing_now() - start;
+    stats->segments++;
+    pipeline_push(&pl.q_output, seg, stats);
+  }
+
+  pipeline_push(&pl.q_output, NULL, stats);
+  return(NULL);
+}
+
+static void* pipeline_output(void* arg) {
+  (void)arg;
+  struct pipeline_stage_stats_t* stats = &pl.stats.stages[PIPELINE_STAGE_OUTPUT];
+  struct pipeline_seg_t* seg;
+  while(pipeline_pop(&pl.q_output, &seg, stats)) {
+    if(!seg) {
+      break;
+    }
+
+    struct segment_t out = { .samples = seg->samples, .offset = seg->offset, .len = seg->len };
+    double start = timing_now();
+    int ret = pl.exporter->write(pl.ctx, &out);
+    stats->busy += timing_now() - start;
+    if(ret != EXIT_SUCCESS) {
+      pipeline_fail(&pl.ret_output);
+      break;
+    }
+    stats->segments++;
+    pipeline_push(&pl.q_free, seg, stats);
+  }
+
+  return(NULL);
+}
+
+static size_t pipeline_raw_size() {
+  return(PIPELINE_SEGMENT_SAMPLES * dma_get_sample_words() * sizeof(uint32_t));
+}
+
+size_t pipeline_mem_size() {
+  return(PIPELINE_NUM_SEGMENTS * (sizeof(struct pipeline_seg_t) + pipeline_raw_size()));
+}
+
+int pipeline_init() {
+  pl.segs = arena_alloc(PIPELINE_NUM_SEGMENTS * sizeof(struct pipeline_seg_t), ARENA_ALIGN_DEFAULT);
+  if(!pl.segs) {
+    fprintf(stderr, "Failed to allocate pipeline segments\n");
+    return(EXIT_FAILURE);
+  }
+
+  for(int i = 0; i < PIPELINE_NUM_SEGMENTS; i++) {
+    pl.segs[i].raw = arena_alloc(pipeline_raw_size(), ARENA_ALIGN_DEFAULT);
+    if(!pl.segs[i].raw) {
+      fprintf(stderr, "Failed to allocate pipeline segments\n");
+      return(EXIT_FAILURE);
+    }
+  }
+  return(EXIT_SUCCESS);
+}
+
+int pipeline_run(struct capture_t* cap, const struct exporter_t* exporter, void* ctx) {
+  pl.cap = cap;
+  pl.exporter = exporter;
+  pl.ctx = ctx;
+  pl.ret_drain = EXIT_SUCCESS;
+  pl.ret_output = EXIT_SUCCESS;
+  atomic_store(&pl.abort, false);
+
+  memset(&pl.stats, 0, sizeof(pl.stats));
+  pl.stats.stages[PIPELINE_STAGE_DRAIN].name = "drain";
+  pl.stats.stages[PIPELINE_STAGE_CONVERT].name = "convert";
+  pl.stats.stages[PIPELINE_STAGE_OUTPUT].name = "output";
+
+  // all segments start in the free queue
+  spsc_init(&pl.q_free, pl.q_free_slots, PIPELINE_NUM_SEGMENTS);
+  spsc_init(&pl.q_convert, pl.q_convert_slots, PIPELINE_NUM_SEGMENTS);
+  spsc_init(&pl.q_output, pl.q_output_slots, PIPELINE_NUM_SEGMENTS);
+  for(int i = 0; i < PIPELINE_NUM_SEGMENTS; i++) {
+    spsc_push(&pl.q_free, &pl.segs[i]);
+  }
+
+  pthread_t threads[PIPELINE_NUM_STAGES];
+  void* (*funcs[PIPELINE_NUM_STAGES])(void*) = { pipeline_drain, pipeline_convert, pipeline_output };
+  int num_started = 0;
+  for(; num_started < PIPELINE_NUM_STAGES; num_started++) {
+    if(pthread_create(&threads[num_started], NULL, funcs[num_started], NULL) != 0) {
+      fprintf(stderr, "Failed to start pipeline thread\n");
+      pipeline_fail(&pl.ret_drain);
+      break;
+    }
+  }
+
+  for(int i = 0; i < num_started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  pl.stats.stages[PIPELINE_STAGE_CONVERT].occupancy_max = pl.q_convert.occupancy_max;
+  pl.stats.stages[PIPELINE_STAGE_OUTPUT].occupancy_max = pl.q_output.occupancy_max;
+
+  if(num_started < PIPELINE_NUM_STAGES) {
+    return(EXIT_FAILURE);
+  }
+  return(((pl.ret_drain == EXIT_SUCCESS) && (pl.ret_output == EXIT_SUCCESS)) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void pipeline_get_stats(struct pipeline_stats_t* stats) {
+  memcpy(stats, &pl.stats, sizeof(pl.stats));
+}
@@ -0,0 +1,60 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+#include "export.h"
+
+// number of samples in a single segment
+#define PIPELINE_SEGMENT_SAMPLES    (64UL*1024UL)
+
+// number of pre-allocated segments circulating through the pipeline, must be a power of 2
+#define PIPELINE_NUM_SEGMENTS       (16)
+
+enum pipeline_stage_e {
+  PIPELINE_STAGE_DRAIN = 0,
+  PIPELINE_STAGE_CONVERT,
+  PIPELINE_STAGE_OUTPUT,
+  PIPELINE_NUM_STAGES,
+};
+
+struct pipeline_stage_stats_t {
+  const char* name;
+
+  // number of segments processed
+  uint64_t segments;
+
+  // time spent processing, without waiting for input or output
+  double busy;
+
+  // number of times the stage had to wait for input (DMA progress or previous stage)
+  uint64_t stalls_in;
+
+  // number of times the stage was blocked by the next stage (no free segment or full queue)
+  uint64_t stalls_out;
+
+  // highest number of segments waiting in the input queue of the stage
+  // for the drain stage, this is the number of segments captured by DMA but not yet drained
+  size_t occupancy_max;
+};
+
+struct pipeline_stats_t {
+  struct pipeline_stage_stats_t stages[PIPELINE_NUM_STAGES];
+};
+
+// number of bytes needed for the segments, DMA must be initialized to know the raw sample size
+size_t pipeline_mem_size();
+
+// allocate all segments from the arena, must be called once before the first capture
+int pipeline_init();
+
+// drain samples from the DMA buffer as the capture progresses, convert them and pass them to the exporter
+// returns once the last sample was written, cap->end is set when the DMA finishes
+int pipeline_run(struct capture_t* cap, const struct exporter_t* exporter, void* ctx);
+
+// get the statistics of the last run
+void pipeline_get_stats(struct pipeline_stats_t* stats);
+
+#endif
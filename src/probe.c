@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "probe.h"
+
+#define PROBE_POLL_US       (100)
+#define PROBE_TIMEOUT_US    (1000000UL)
+
+// improvement needed to prefer setting later in the list, the timer resolution is 1 us
+#define PROBE_MARGIN        (1.01)
+
+// tested settings, priority and panic priority for each of them is tried with and without waiting for write response
+// the defaults go first, so they are kept unless something else is clearly better
+static const unsigned int priorities[][2] = {
+  { 8, 8 },
+  { 8, 15 },
+  { 15, 15 },
+  { 0, 0 },
+};
+
+// run single capture and evaluate the timestamps
+static int probe_run(size_t num_samples, const struct dma_opts_t* opts, double* sustained, double* worst) {
+  dma_init(num_samples, 0, opts);
+  dma_start();
+
+  unsigned long idle_us = 0;
+  size_t progress = 0;
+  while(progress < num_samples) {
+    size_t curr = dma_get_progress();
+    if(curr != progress) {
+      progress = curr;
+      idle_us = 0;
+      continue;
+    }
+
+    if(dma_failed() || (idle_us >= PROBE_TIMEOUT_US)) {
+      fprintf(stderr, "DMA %s at sample %lu of %lu\n", dma_failed() ? "error" : "stalled", progress, num_samples);
+      dma_end();
+      return(EXIT_FAILURE);
+    }
+    usleep(PROBE_POLL_US);
+    idle_us += PROBE_POLL_US;
+  }
+
+  // timestamp N was taken before sample N*DMA_TIMESTAMP_INTERVAL, the last one after the final sample
+  const uint32_t* ts;
+  size_t num_ts = dma_get_timestamps(&ts);
+  *worst = 0;
+  for(size_t i = 0; i + 1 < num_ts; i++) {
+    size_t samples = num_samples - i*DMA_TIMESTAMP_INTERVAL;
+    if(samples > DMA_TIMESTAMP_INTERVAL) { samples = DMA_TIMESTAMP_INTERVAL; }
+
+    // the timer ticks at 1 MHz, interval too short to measure does not limit the rate
+    uint32_t dt = ts[i + 1] - ts[i];
+    if(dt == 0) {
+      continue;
+    }
+    double rate = (double)samples * 1.0e6 / (double)dt;
+    if((*worst == 0) || (rate < *worst)) { *worst = rate; }
+  }
+
+  uint32_t total = (num_ts > 1) ? ts[num_ts - 1] - ts[0] : 0;
+  *sustained = total ? (double)num_samples * 1.0e6 / (double)total : 0;
+  dma_end();
+  return(EXIT_SUCCESS);
+}
+
+int probe_rate(size_t num_samples, unsigned int runs, struct probe_result_t* best) {
+  fprintf(stdout, "Probing sample rate, %lu samples, %u runs per setting\n", num_samples, runs);
+  fprintf(stdout, "priority  panic  wait_resp  sustained [MSps]  worst [MSps]\n");
+
+  bool found = false;
+  for(size_t i = 0; i < sizeof(priorities)/sizeof(priorities[0]); i++) {
+    for(int wait_resp = 1; wait_resp >= 0; wait_resp--) {
+      struct probe_result_t res = {
+        .opts = { .priority = priorities[i][0], .panic_priority = priorities[i][1], .wait_resp = wait_resp, .timestamps = true },
+        .sustained = 0,
+        .worst = 0,
+      };
+
+      // average of sustained rates, worst of the worst cases
+      for(unsigned int r = 0; r < runs; r++) {
+        double sustained, worst;
+        if(probe_run(num_samples, &res.opts, &sustained, &worst) != EXIT_SUCCESS) {
+          return(EXIT_FAILURE);
+        }
+        res.sustained += sustained / runs;
+        if((r == 0) || (worst < res.worst)) { res.worst = worst; }
+      }
+
+      fprintf(stdout, "%8u  %5u  %9s  %16.3f  %12.3f\n", res.opts.priority, res.opts.panic_priority,
+        res.opts.wait_resp ? "yes" : "no", res.sustained/1.0e6, res.worst/1.0e6);
+
+      // the worst case decides what can be decoded reliably
+      if(!found || (res.worst > best->worst * PROBE_MARGIN)) {
+        *best = res;
+        found = true;
+      }
+    }
+  }
+
+  best->opts.timestamps = false;
+  fprintf(stdout, "Recommended: --dma-priority %u --dma-panic-priority %u%s\n", best->opts.priority,
+    best->opts.panic_priority, best->opts.wait_resp ? "" : " --no-wait-resp");
+  fprintf(stdout, "Sustained rate %.3f MSps, worst case %.3f MSps\n", best->sustained/1.0e6, best->worst/1.0e6);
+  return(EXIT_SUCCESS);
+}
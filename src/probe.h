@@ -0,0 +1,20 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stddef.h>
+
+#include "dma/dma.h"
+
+struct probe_result_t {
+  struct dma_opts_t opts;
+
+  // average sample rate over the whole capture, and the lowest rate of any timestamp interval, in Hz
+  double sustained;
+  double worst;
+};
+
+// run unthrottled captures of num_samples with all tested DMA settings, runs times each
+// prints the results and recommended settings, which are also stored to best
+int probe_rate(size_t num_samples, unsigned int runs, struct probe_result_t* best);
+
+#endif
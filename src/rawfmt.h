@@ -0,0 +1,73 @@
+#ifndef RAWFMT_H
+#define RAWFMT_H
+
+/*
+  Raw capture file layout, all values are little-endian.
+
+  The file starts with a fixed-size header, followed by sections at page-aligned offsets.
+  The samples section holds packed samples of unitsize bytes each, bit N is the state of channel N.
+  Readers can simply mmap the samples section at the offset given by the section table.
+
+  offset  size  field
+  0       8     magic "PNLZRAW\0"
+  8       4     format version
+  12      4     header length (= offset of the first section)
+  16      4     number of channels
+  20      4     unitsize in bytes
+  24      8     number of samples
+  32      8     sampling rate in Hz (IEEE 754 double)
+  40      8     trigger sample index
+  48      8     capture start, seconds since epoch
+  56      8     capture start, nanoseconds
+  64      8     capture end, seconds since epoch
+  72      8     capture end, nanoseconds
+  80      4     number of sections
+  84      4     reserved
+  88      24*8  section table, see below
+  512     64    BCM pin number of each channel
+  576     32*64 channel labels, NUL-terminated
+
+  section table entry:
+  0       4     section type
+  4       4     reserved
+  8       8     offset from the start of the file
+  16      8     length in bytes
+*/
+
+#define RAW_MAGIC                   "PNLZRAW"
+#define RAW_VERSION                 (1)
+
+// section data is aligned to this, so that it can be directly mmap-ed
+#define RAW_ALIGN                   (4096UL)
+#define RAW_HEADER_LEN              RAW_ALIGN
+
+#define RAW_OFFS_MAGIC              (0)
+#define RAW_OFFS_VERSION            (8)
+#define RAW_OFFS_HEADER_LEN         (12)
+#define RAW_OFFS_NUM_CHANNELS       (16)
+#define RAW_OFFS_UNITSIZE           (20)
+#define RAW_OFFS_NUM_SAMPLES        (24)
+#define RAW_OFFS_SAMP_RATE          (32)
+#define RAW_OFFS_TRIG_IDX           (40)
+#define RAW_OFFS_START_SEC          (48)
+#define RAW_OFFS_START_NSEC         (56)
+#define RAW_OFFS_END_SEC            (64)
+#define RAW_OFFS_END_NSEC           (72)
+#define RAW_OFFS_NUM_SECTIONS       (80)
+#define RAW_OFFS_SECTIONS           (88)
+#define RAW_OFFS_PINS               (512)
+#define RAW_OFFS_LABELS             (576)
+
+#define RAW_SECTIONS_MAX            (8)
+#define RAW_SECTION_LEN             (24)
+#define RAW_CHANNELS_MAX            (64)
+#define RAW_LABEL_LEN               (32)
+
+enum raw_section_e {
+  RAW_SECTION_SAMPLES = 1,
+
+  // min/max summary pyramid, optional, layout described in summary.h
+  RAW_SECTION_SUMMARY = 2,
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <zip.h>
+
+#include "replay.h"
+#include "convert.h"
+
+// packed samples are decompressed this many bytes at a time
+#define REPLAY_READ_LEN             (256UL*1024UL)
+
+#define REPLAY_METADATA_LEN_MAX     (4096)
+#define REPLAY_LABEL_LEN            (32)
+#define REPLAY_NAME_LEN             (64)
+
+struct replay_t {
+  zip_t* z;
+  unsigned int unitsize;
+
+  // sample entries in playback order, sigrok splits large captures into logic-1-1, logic-1-2, ...
+  zip_uint64_t* entries;
+  size_t num_entries;
+  size_t entry;
+  zip_file_t* file;
+
+  // decompressed bytes not yet returned, may end in the middle of a sample
+  uint8_t* buff;
+  size_t buff_len;
+
+  int pins[REPLAY_CHANNELS_MAX];
+  char label_buffs[REPLAY_CHANNELS_MAX][REPLAY_LABEL_LEN];
+  const char* labels[REPLAY_CHANNELS_MAX];
+};
+
+// sample rate as written by sigrok, e.g. "5 MHz" or "5.000000 MHz"
+static double replay_parse_rate(const char* str) {
+  double val;
+  char unit[8] = { 0 };
+  if(sscanf(str, "%lf %7s", &val, unit) < 1) {
+    return(0);
+  }
+  if(strcasecmp(unit, "GHz") == 0) { return(val * 1e9); }
+  if(strcasecmp(unit, "MHz") == 0) { return(val * 1e6); }
+  if(strcasecmp(unit, "kHz") == 0) { return(val * 1e3); }
+  return(val);
+}
+
+static int replay_parse_metadata(struct replay_t* r, struct capture_t* cap, char* capturefile) {
+  zip_file_t* file = zip_fopen(r->z, "metadata", 0);
+  if(!file) {
+    fprintf(stderr, "No metadata in the archive: %s\n", zip_strerror(r->z));
+    return(EXIT_FAILURE);
+  }
+  char buff[REPLAY_METADATA_LEN_MAX];
+  zip_int64_t len = zip_fread(file, buff, sizeof(buff) - 1);
+  zip_fclose(file);
+  if(len < 0) {
+    fprintf(stderr, "Failed to read metadata: %s\n", zip_strerror(r->z));
+    return(EXIT_FAILURE);
+  }
+  buff[len] = '\0';
+
+  // only the first device is replayed
+  int device = 0;
+  strcpy(capturefile, "logic-1");
+  for(char* line = strtok(buff, "\r\n"); line; line = strtok(NULL, "\r\n")) {
+    int num;
+    if(line[0] == '[') {
+      device += (strncmp(line, "[device", 7) == 0);
+      continue;
+    }
+    if(device != 1) {
+      continue;
+    }
+
+    char* val = strchr(line, '=');
+    if(!val) {
+      continue;
+    }
+    *val++ = '\0';
+    if(strcmp(line, "capturefile") == 0) {
+      snprintf(capturefile, REPLAY_NAME_LEN, "%s", val);
+    } else if(strcmp(line, "total probes") == 0) {
+      cap->num_pins = atoi(val);
+    } else if(strcmp(line, "samplerate") == 0) {
+      cap->samp_rate = replay_parse_rate(val);
+    } else if(strcmp(line, "unitsize") == 0) {
+      r->unitsize = atoi(val);
+    } else if((sscanf(line, "probe%d", &num) == 1) && (num >= 1) && (num <= REPLAY_CHANNELS_MAX)) {
+      snprintf(r->label_buffs[num - 1], REPLAY_LABEL_LEN, "%s", val);
+    }
+  }
+
+  if((cap->num_pins == 0) || (cap->num_pins > REPLAY_CHANNELS_MAX)) {
+    fprintf(stderr, "Unsupported number of channels: %u, at most %d can be replayed\n", cap->num_pins, REPLAY_CHANNELS_MAX);
+    return(EXIT_FAILURE);
+  }
+  if((r->unitsize == 0) || (r->unitsize > sizeof(uint32_t)) || (r->unitsize < (cap->num_pins + 7) / 8)) {
+    fprintf(stderr, "Invalid unitsize: %u\n", r->unitsize);
+    return(EXIT_FAILURE);
+  }
+  if(cap->samp_rate <= 0) {
+    fprintf(stderr, "Missing sample rate\n");
+    return(EXIT_FAILURE);
+  }
+
+  for(unsigned int i = 0; i < cap->num_pins; i++) {
+    if(r->label_buffs[i][0] == '\0') {
+      snprintf(r->label_buffs[i], REPLAY_LABEL_LEN, "%d", i + 1);
+    }
+    r->labels[i] = r->label_buffs[i];
+    if(sscanf(r->labels[i], "BCM%d", &r->pins[i]) != 1) {
+      r->pins[i] = i;
+    }
+  }
+  return(EXIT_SUCCESS);
+}
+
+// number of the chunk from the entry name, -1 if the entry does not hold samples
+static long replay_chunk(const char* name, const char* capturefile) {
+  size_t len = strlen(capturefile);
+  if(strncmp(name, capturefile, len) != 0) {
+    return(-1);
+  }
+  if(name[len] == '\0') {
+    return(0);
+  }
+  char* end;
+  long num = (name[len] == '-') ? strtol(&name[len + 1], &end, 10) : -1;
+  return(((num < 0) || (*end != '\0')) ? -1 : num);
+}
+
+static int replay_find_entries(struct replay_t* r, struct capture_t* cap, const char* capturefile) {
+  zip_int64_t num = zip_get_num_entries(r->z, 0);
+  if(num < 0) {
+    fprintf(stderr, "Failed to list the archive: %s\n", zip_strerror(r->z));
+    return(EXIT_FAILURE);
+  }
+
+  r->entries = calloc(num, sizeof(zip_uint64_t));
+  long* chunks = calloc(num, sizeof(long));
+  if(!r->entries || !chunks) {
+    free(chunks);
+    return(EXIT_FAILURE);
+  }
+
+  // insertion sort by chunk number, there are only a few of them
+  uint64_t bytes = 0;
+  for(zip_int64_t i = 0; i < num; i++) {
+    zip_stat_t st;
+    if((zip_stat_index(r->z, i, 0, &st) != 0) || !(st.valid & ZIP_STAT_NAME) || !(st.valid & ZIP_STAT_SIZE)) {
+      continue;
+    }
+    long chunk = replay_chunk(st.name, capturefile);
+    if(chunk < 0) {
+      continue;
+    }
+
+    size_t pos = r->num_entries;
+    while((pos > 0) && (chunks[pos - 1] > chunk)) {
+      chunks[pos] = chunks[pos - 1];
+      r->entries[pos] = r->entries[pos - 1];
+      pos--;
+    }
+    chunks[pos] = chunk;
+    r->entries[pos] = i;
+    r->num_entries++;
+    bytes += st.size;
+  }
+  free(chunks);
+
+  if(r->num_entries == 0) {
+    fprintf(stderr, "No samples in the archive\n");
+    return(EXIT_FAILURE);
+  }
+  cap->num_samples = bytes / r->unitsize;
+  return(EXIT_SUCCESS);
+}
+
+struct replay_t* replay_open(const char* filename, struct capture_t* cap) {
+  struct replay_t* r = calloc(1, sizeof(struct replay_t));
+  if(!r) {
+    return(NULL);
+  }
+  r->buff = malloc(REPLAY_READ_LEN + sizeof(uint32_t));
+
+  int err = 0;
+  r->z = zip_open(filename, ZIP_RDONLY, &err);
+  if(!r->z) {
+    zip_error_t zip_err;
+    zip_error_init_with_code(&zip_err, err);
+    fprintf(stderr, "Cannot open zip file %s: %s\n", filename, zip_error_strerror(&zip_err));
+    zip_error_fini(&zip_err);
+    replay_close(r);
+    return(NULL);
+  }
+
+  memset(cap, 0, sizeof(struct capture_t));
+  char capturefile[REPLAY_NAME_LEN];
+  if(!r->buff || (replay_parse_metadata(r, cap, capturefile) != EXIT_SUCCESS) || (replay_find_entries(r, cap, capturefile) != EXIT_SUCCESS)) {
+    replay_close(r);
+    return(NULL);
+  }
+  cap->pins = r->pins;
+  cap->labels = r->labels;
+  return(r);
+}
+
+long replay_read(struct replay_t* r, uint32_t* samples, size_t max) {
+  size_t done = 0;
+  while(done < max) {
+    // whole samples first
+    size_t avail = r->buff_len / r->unitsize;
+    if(avail) {
+      if(avail > max - done) { avail = max - done; }
+      convert_unpack(r->buff, &samples[done], avail, r->unitsize);
+      r->buff_len -= avail * r->unitsize;
+      memmove(r->buff, &r->buff[avail * r->unitsize], r->buff_len);
+      done += avail;
+      continue;
+    }
+
+    // then decompress more, moving on to the next entry when one runs out
+    if(!r->file) {
+      if(r->entry == r->num_entries) {
+        break;
+      }
+      r->file = zip_fopen_index(r->z, r->entries[r->entry], 0);
+      if(!r->file) {
+        fprintf(stderr, "Failed to open samples: %s\n", zip_strerror(r->z));
+        return(-1);
+      }
+    }
+
+    zip_int64_t len = zip_fread(r->file, &r->buff[r->buff_len], REPLAY_READ_LEN);
+    if(len < 0) {
+      fprintf(stderr, "Failed to decompress samples: %s\n", zip_strerror(r->z));
+      return(-1);
+    }
+    if(len == 0) {
+      zip_fclose(r->file);
+      r->file = NULL;
+      r->entry++;
+    }
+    r->buff_len += len;
+  }
+  return(done);
+}
+
+void replay_close(struct replay_t* r) {
+  if(r->file) { zip_fclose(r->file); }
+  if(r->z) { zip_discard(r->z); }
+  free(r->entries);
+  free(r->buff);
+  free(r);
+}
@@ -0,0 +1,25 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+
+// maximum number of channels in a replayed file, samples are channel words
+#define REPLAY_CHANNELS_MAX         (32)
+
+// reader of an existing sigrok session file
+struct replay_t;
+
+// open the file and describe its contents in cap, returns NULL on failure
+// channels labeled BCMx get pin x, all others their channel index
+struct replay_t* replay_open(const char* filename, struct capture_t* cap);
+
+// decompress the next samples as channel words, up to max of them
+// returns the number of samples read, 0 at the end of the file or -1 on failure
+long replay_read(struct replay_t* r, uint32_t* samples, size_t max);
+
+void replay_close(struct replay_t* r);
+
+#endif
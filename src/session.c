@@ -0,0 +1,377 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "dma/dma.h"
+#include "dma/hal.h"
+#include "dma/registers.h"
+
+#include "session.h"
+#include "pipeline.h"
+#include "arena.h"
+#include "timing.h"
+
+// extra arena space for small allocations of the exporters
+#define SESSION_ARENA_SLACK           (64UL*1024UL)
+
+enum session_state_e {
+  SESSION_STATE_IDLE = 0,
+  SESSION_STATE_CONFIGURED,
+  SESSION_STATE_ARMED,
+  SESSION_STATE_DONE,
+};
+
+struct session_t {
+  enum session_state_e state;
+
+  // copy of the configuration, so that the caller does not need to keep it around
+  struct session_conf_t conf;
+  int pins[SESSION_PINS_MAX];
+  const char* labels[SESSION_PINS_MAX];
+  char label_buffs[SESSION_PINS_MAX][SESSION_LABEL_LEN_MAX];
+
+  struct capture_t cap;
+  const struct exporter_t* exporter;
+  void* ctx;
+  size_t mark;
+
+  // in-memory copy of the samples, same as ctx when there is no output file
+  void* mem_ctx;
+};
+
+// DMA and the arena are process-wide
+static bool session_active = false;
+
+// with keep_samples, the output file and the in-memory copy are written from the same segments
+static int session_tee_write(void* ctx, const struct segment_t* seg) {
+  struct session_t* s = (struct session_t*)ctx;
+  if(exporter_mem.write(s->mem_ctx, seg) != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+  return(s->exporter->write(s->ctx, seg));
+}
+
+static const struct exporter_t session_tee = {
+  .name = "tee",
+  .ext = "",
+  .mem_size = NULL,
+  .open = NULL,
+  .write = session_tee_write,
+  .close = NULL,
+};
+
+static bool session_keeps_copy(const struct session_t* s) {
+  return(s->conf.keep_samples && (s->exporter != &exporter_mem));
+}
+
+static int session_get_gpio(int pin) {
+  return((hal_get()->gpio_read(pin / 32) & (1UL << (pin & 31))) != 0);
+}
+
+static void session_wait_for_trigger(const struct session_t* s) {
+  bool triggered = false;
+  int curr;
+  int prev = session_get_gpio(s->pins[0]);
+  while(!triggered) {
+    curr = session_get_gpio(s->pins[0]);
+    triggered = trigger_edge(s->conf.trig, prev, curr);
+    prev = curr;
+  }
+}
+
+// get available system memory in bytes, or 0 if unknown
+static size_t session_mem_available() {
+  FILE* fp = fopen("/proc/meminfo", "r");
+  if(!fp) {
+    return(0);
+  }
+
+  char line[128];
+  unsigned long kbytes = 0;
+  while(fgets(line, sizeof(line), fp)) {
+    if(sscanf(line, "MemAvailable: %lu kB", &kbytes) == 1) {
+      break;
+    }
+  }
+  fclose(fp);
+  return(kbytes * 1024UL);
+}
+
+static int session_init_memory(struct session_t* s) {
+  // everything that will be needed, so that we know the capture fits before waiting for the trigger
+  size_t dma_bytes = dma_get_mem_size();
+  size_t staging_bytes = pipeline_mem_size();
+  size_t output_bytes = s->exporter->mem_size(&s->cap, &s->conf.export_opts);
+  if(session_keeps_copy(s)) {
+    output_bytes += exporter_mem.mem_size(&s->cap, &s->conf.export_opts);
+  }
+  size_t arena_bytes = staging_bytes + output_bytes + SESSION_ARENA_SLACK;
+  if(s->conf.verbose) {
+    fprintf(stdout, "Memory plan: DMA %lu bytes, staging %lu bytes, output %lu bytes\n", dma_bytes, staging_bytes, output_bytes);
+  }
+
+  size_t available = session_mem_available();
+  if(available && (arena_bytes > available)) {
+    fprintf(stderr, "Capture needs %lu bytes, but only %lu bytes are available\n", arena_bytes, available);
+    return(EXIT_FAILURE);
+  }
+
+  timing_begin(TIMING_PHASE_MEMORY);
+  arena_free();
+  int ret = arena_init(arena_bytes);
+  if(ret == EXIT_SUCCESS) {
+    ret = pipeline_init();
+  }
+  timing_end(TIMING_PHASE_MEMORY);
+  if(ret != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+
+  if(s->conf.verbose) {
+    fprintf(stdout, "Reserved %lu bytes%s\n", arena_size(), arena_is_huge() ? " in hugepages" : "");
+  }
+  return(EXIT_SUCCESS);
+}
+
+// set up the control blocks, this has to be done again after every run
+static void session_init_dma(struct session_t* s) {
+  dma_init(s->conf.num_samples, (s->conf.rate >= SESSION_RATE_NO_THROTTLE) ? 0 : s->conf.rate, &s->conf.dma_opts);
+
+  memset(&s->cap, 0, sizeof(s->cap));
+  s->cap.num_pins = s->conf.num_pins;
+  s->cap.pins = s->pins;
+  s->cap.labels = s->labels;
+  s->cap.num_samples = s->conf.num_samples;
+  s->cap.samp_rate = s->conf.rate;
+  s->cap.trig_idx = 0;
+
+  // with rate limiting, the exact rate is known from the clock configuration
+  struct dma_clock_t clk;
+  if(dma_get_clock(&clk)) {
+    s->cap.samp_rate = clk.rate;
+    if(s->conf.verbose) {
+      fprintf(stdout, "Sample rate %u Sps requested, %.3f Sps actual (%s clock, divider %u + %u/4096, range %u)\n",
+        s->conf.rate, clk.rate, (clk.src == CLK_CTL_SRC_OSC) ? "oscillator" : "PLLD", clk.divi, clk.divf, clk.range);
+    }
+  }
+
+  struct dma_timing_t dma_timing;
+  dma_get_timing(&dma_timing);
+  timing_set(TIMING_PHASE_DMA_MAP, dma_timing.map);
+  timing_set(TIMING_PHASE_DMA_ALLOC, dma_timing.alloc);
+  timing_set(TIMING_PHASE_DMA_CBS, dma_timing.init_cbs);
+}
+
+struct session_t* session_open() {
+  if(session_active) {
+    fprintf(stderr, "Another capture session is already open\n");
+    return(NULL);
+  }
+
+  struct session_t* s = calloc(1, sizeof(struct session_t));
+  if(!s) {
+    return(NULL);
+  }
+  session_active = true;
+  return(s);
+}
+
+int session_configure(struct session_t* s, const struct session_conf_t* conf) {
+  if((s->state == SESSION_STATE_ARMED) && s->ctx) {
+    s->exporter->close(s->ctx);
+  }
+  s->state = SESSION_STATE_IDLE;
+  s->ctx = NULL;
+  s->mem_ctx = NULL;
+  dma_end();
+
+  if((conf->num_pins < 1) || (conf->num_pins > SESSION_PINS_MAX)) {
+    fprintf(stderr, "Invalid number of capture pins: %u\n", conf->num_pins);
+    return(EXIT_FAILURE);
+  }
+
+  s->conf = *conf;
+  for(unsigned int i = 0; i < conf->num_pins; i++) {
+    s->pins[i] = conf->pins[i];
+    if((s->pins[i] < 0) || (s->pins[i] > SESSION_GPIO_PIN_MAX)) {
+      fprintf(stderr, "Invalid pin: %d, must be 0 - %d\n", s->pins[i], SESSION_GPIO_PIN_MAX);
+      return(EXIT_FAILURE);
+    }
+
+    // only read the second bank when needed, it doubles the amount of DMA data
+    if(s->pins[i] >= 32) {
+      s->conf.dma_opts.bank1 = true;
+    }
+    if(conf->labels && conf->labels[i]) {
+      if(snprintf(s->label_buffs[i], SESSION_LABEL_LEN_MAX, "%s", conf->labels[i]) >= SESSION_LABEL_LEN_MAX) {
+        fprintf(stderr, "Label too long: %s, must be at most %d characters\n", conf->labels[i], SESSION_LABEL_LEN_MAX - 1);
+        return(EXIT_FAILURE);
+      }
+    } else {
+      sprintf(s->label_buffs[i], "BCM%d", s->pins[i]);
+    }
+    s->labels[i] = s->label_buffs[i];
+  }
+  s->conf.pins = s->pins;
+  s->conf.labels = s->labels;
+
+  if(s->conf.rate == 0) {
+    s->conf.rate = board_get()->rate_default;
+  }
+  if(s->conf.num_samples == 0) {
+    fprintf(stderr, "Capture too short for sample rate %u Sps\n", s->conf.rate);
+    return(EXIT_FAILURE);
+  }
+
+  s->exporter = s->conf.exporter ? s->conf.exporter : &exporter_mem;
+  if(s->conf.export_opts.async && (s->exporter != &exporter_raw)) {
+    fprintf(stderr, "Asynchronous writes are only supported for raw format\n");
+    return(EXIT_FAILURE);
+  }
+  if(s->conf.export_opts.direct && !s->conf.export_opts.async) {
+    fprintf(stderr, "Direct writes are only supported with asynchronous writes\n");
+    return(EXIT_FAILURE);
+  }
+  if(s->conf.export_opts.summary && (s->exporter != &exporter_sr) && (s->exporter != &exporter_raw)) {
+    fprintf(stderr, "Summary is only supported for sr and raw formats\n");
+    return(EXIT_FAILURE);
+  }
+
+  session_init_dma(s);
+
+  // allocate everything needed for processing before the capture starts
+  if(session_init_memory(s) != EXIT_SUCCESS) {
+    return(EXIT_FAILURE);
+  }
+
+  s->state = SESSION_STATE_CONFIGURED;
+  return(EXIT_SUCCESS);
+}
+
+int session_arm(struct session_t* s) {
+  if(s->state == SESSION_STATE_ARMED) {
+    return(EXIT_SUCCESS);
+  }
+  if(s->state == SESSION_STATE_IDLE) {
+    fprintf(stderr, "Session is not configured\n");
+    return(EXIT_FAILURE);
+  }
+
+  // output of the previous run is dropped, and nothing is allocated from now until the output is closed
+  if(s->state == SESSION_STATE_DONE) {
+    arena_release(s->mark);
+    session_init_dma(s);
+  }
+  s->mark = arena_mark();
+
+  timing_begin(TIMING_PHASE_OPEN);
+  s->mem_ctx = NULL;
+  if(session_keeps_copy(s)) {
+    s->mem_ctx = exporter_mem.open(NULL, &s->cap, &s->conf.export_opts);
+  }
+  s->ctx = s->exporter->open(s->conf.filename, &s->cap, &s->conf.export_opts);
+  if(s->exporter == &exporter_mem) {
+    s->mem_ctx = s->ctx;
+  }
+  timing_end(TIMING_PHASE_OPEN);
+  if(!s->ctx || (s->conf.keep_samples && !s->mem_ctx)) {
+    if(s->ctx) {
+      s->exporter->close(s->ctx);
+      s->ctx = NULL;
+    }
+    s->mem_ctx = NULL;
+    fprintf(stderr, "Failed to open %s\n", s->conf.filename ? s->conf.filename : "output");
+    arena_release(s->mark);
+    s->state = SESSION_STATE_CONFIGURED;
+    return(EXIT_FAILURE);
+  }
+
+  s->state = SESSION_STATE_ARMED;
+  return(EXIT_SUCCESS);
+}
+
+int session_wait(struct session_t* s) {
+  if(s->state != SESSION_STATE_ARMED) {
+    fprintf(stderr, "Session is not armed\n");
+    return(EXIT_FAILURE);
+  }
+
+  if(s->conf.trig != TRIG_TYPE_IMMEDIATE) {
+    if(s->conf.verbose) {
+      fprintf(stdout, "Waiting for trigger\n");
+    }
+    timing_begin(TIMING_PHASE_TRIGGER);
+    session_wait_for_trigger(s);
+    timing_end(TIMING_PHASE_TRIGGER);
+  }
+
+  timing_begin(TIMING_PHASE_CAPTURE);
+  timespec_get(&s->cap.start, TIME_UTC);
+  dma_start();
+  if(s->conf.verbose) {
+    fprintf(stdout, "Running capture\n");
+  }
+
+  // samples are drained, converted and written while the DMA is still running
+  int ret;
+  if(session_keeps_copy(s)) {
+    ret = pipeline_run(&s->cap, &session_tee, s);
+  } else {
+    ret = pipeline_run(&s->cap, s->exporter, s->ctx);
+  }
+  timing_end(TIMING_PHASE_CAPTURE);
+
+  // a ring of control blocks keeps running until stopped, the DMA has to be set up again for the next run
+  dma_end();
+
+  timing_begin(TIMING_PHASE_CLOSE);
+  if(s->exporter->close(s->ctx) != EXIT_SUCCESS) {
+    ret = EXIT_FAILURE;
+  }
+  timing_end(TIMING_PHASE_CLOSE);
+
+  // in-memory samples stay in the arena until the next run, files are done with it
+  s->ctx = NULL;
+  if(!s->mem_ctx) {
+    arena_release(s->mark);
+  }
+
+  s->state = SESSION_STATE_DONE;
+  return(ret);
+}
+
+int session_read_samples(struct session_t* s, size_t offset, size_t len, struct segment_t* view) {
+  if((s->state != SESSION_STATE_DONE) || !s->mem_ctx) {
+    fprintf(stderr, "No samples in memory\n");
+    return(EXIT_FAILURE);
+  }
+  if((offset > s->cap.num_samples) || (len > s->cap.num_samples - offset)) {
+    fprintf(stderr, "Samples %lu - %lu out of range of %lu\n", offset, offset + len, s->cap.num_samples);
+    return(EXIT_FAILURE);
+  }
+
+  view->samples = &export_mem_samples(s->mem_ctx)[offset];
+  view->offset = offset;
+  view->len = len;
+  return(EXIT_SUCCESS);
+}
+
+const struct capture_t* session_get_capture(const struct session_t* s) {
+  return(&s->cap);
+}
+
+void session_close(struct session_t* s) {
+  if(!s) {
+    return;
+  }
+
+  if((s->state == SESSION_STATE_ARMED) && s->ctx) {
+    s->exporter->close(s->ctx);
+  }
+  dma_end();
+  arena_free();
+  free(s);
+  session_active = false;
+}
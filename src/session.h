@@ -0,0 +1,80 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "dma/dma.h"
+
+#include "capture.h"
+#include "export.h"
+#include "trigger.h"
+
+// maximum number of pins we support, pins can be anywhere in GPIO 0..53
+// pins 32 and above are only exposed on compute modules, and require sampling of the second bank
+#define SESSION_PINS_MAX              32
+#define SESSION_GPIO_PIN_MAX          53
+
+// longest channel label, including the terminating null
+#define SESSION_LABEL_LEN_MAX         64
+
+// highest sample rate, and the rate from which DMA runs without rate limiting
+#define SESSION_RATE_MAX              5000000
+#define SESSION_RATE_NO_THROTTLE      1000000
+
+// capture session, there is only one DMA channel so only one session can be open at a time
+struct session_t;
+
+struct session_conf_t {
+  // BCM pin numbers, the first one is the trigger source
+  const int* pins;
+  unsigned int num_pins;
+
+  // channel labels, NULL or NULL entries default to the pin names
+  const char* const* labels;
+
+  // sample rate in Sps, 0 for the default of the board, and number of samples to capture
+  unsigned int rate;
+  size_t num_samples;
+
+  enum trig_type_e trig;
+  struct dma_opts_t dma_opts;
+
+  // output format and file, NULL exporter keeps the samples in memory for session_read_samples
+  const struct exporter_t* exporter;
+  const char* filename;
+  struct export_opts_t export_opts;
+
+  // keep the samples in memory for session_read_samples even when writing an output file
+  bool keep_samples;
+
+  // print progress and the memory plan to stdout
+  bool verbose;
+};
+
+// create a session, returns NULL if another one is open
+// the board must be detected by board_init or board_use_default before this
+struct session_t* session_open();
+
+// set up DMA and reserve all memory for the capture, can be called again to reconfigure
+int session_configure(struct session_t* s, const struct session_conf_t* conf);
+
+// open the output, after this the capture starts with the trigger
+int session_arm(struct session_t* s);
+
+// wait for the trigger and run the whole capture, returns EXIT_SUCCESS once all samples are in the output
+int session_wait(struct session_t* s);
+
+// get a view of len samples at offset from the start of the capture, without copying
+// only valid for sessions without output file or with keep_samples, until the session is reconfigured or closed
+// returns EXIT_FAILURE if the samples are not available
+int session_read_samples(struct session_t* s, size_t offset, size_t len, struct segment_t* view);
+
+// description of the configured capture, including the actual sample rate
+const struct capture_t* session_get_capture(const struct session_t* s);
+
+// stop DMA and release everything
+void session_close(struct session_t* s);
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sigstats.h"
+
+static void sigstats_add(struct sigstats_pulses_t* pulses, size_t width) {
+  if((pulses->num == 0) || (width < pulses->min)) { pulses->min = width; }
+  if(width > pulses->max) { pulses->max = width; }
+  pulses->mean += (double)width;
+  pulses->num++;
+}
+
+// everything comes from the edge list, so the samples are not scanned again
+static void sigstats_channel(const struct edges_t* edges, unsigned int ch, double samp_rate, struct sigstats_t* st) {
+  memset(st, 0, sizeof(struct sigstats_t));
+  const size_t* idx = edges->idx[ch];
+  size_t num = edges->num[ch];
+  st->edges = num;
+  if(num == 0) {
+    // a stuck channel is at its constant level all the time
+    st->idle_max = edges->num_samples;
+    st->duty = (double)((edges->initial >> ch) & 1);
+    return;
+  }
+
+  // level after edge i alternates, starting from the opposite of the initial level
+  int level = !((edges->initial >> ch) & 1);
+  size_t first_rise = 0, last_rise = 0, rises = 0;
+  size_t high_samples = level ? 0 : idx[0];
+  st->idle_max = idx[0];
+  for(size_t i = 0; i < num; i++) {
+    if(level) {
+      if(rises == 0) { first_rise = idx[i]; }
+      last_rise = idx[i];
+      rises++;
+    }
+
+    if(i + 1 < num) {
+      size_t width = idx[i + 1] - idx[i];
+      sigstats_add(level ? &st->high : &st->low, width);
+      if(level) { high_samples += width; }
+      if(width > st->idle_max) { st->idle_max = width; }
+    }
+    level = !level;
+  }
+  if(edges->num_samples - idx[num - 1] > st->idle_max) {
+    st->idle_max = edges->num_samples - idx[num - 1];
+  }
+  if(!level) { high_samples += edges->num_samples - idx[num - 1]; }
+
+  // from the means, so that a pulse cut off by the end of capture does not skew the duty cycle
+  if(st->high.num) { st->high.mean /= (double)st->high.num; }
+  if(st->low.num) { st->low.mean /= (double)st->low.num; }
+  // without complete pulses of both levels, this is the time spent high including the cut off ones
+  if(st->high.num && st->low.num) {
+    st->duty = st->high.mean / (st->high.mean + st->low.mean);
+  } else {
+    st->duty = (double)high_samples / (double)edges->num_samples;
+  }
+  if(rises > 1) {
+    st->freq = (double)(rises - 1) * samp_rate / (double)(last_rise - first_rise);
+  }
+}
+
+void sigstats_compute(const struct edges_t* edges, const struct capture_t* cap, struct sigstats_t* stats) {
+  for(unsigned int ch = 0; ch < cap->num_pins; ch++) {
+    sigstats_channel(edges, ch, cap->samp_rate, &stats[ch]);
+  }
+}
+
+void sigstats_print(FILE* fp, const struct capture_t* cap, const struct sigstats_t* stats) {
+  double us = 1.0e6 / cap->samp_rate;
+  fprintf(fp, "%-12s %10s %14s %6s %26s %26s %12s\n", "channel", "edges", "freq [Hz]", "duty", "high min/mean/max [us]", "low min/mean/max [us]", "idle [us]");
+  for(unsigned int ch = 0; ch < cap->num_pins; ch++) {
+    const struct sigstats_t* st = &stats[ch];
+    fprintf(fp, "%-12s %10lu %14.3f %6.3f %8.3f/%8.3f/%8.3f %8.3f/%8.3f/%8.3f %12.3f\n", cap->labels[ch], st->edges, st->freq, st->duty,
+      (double)st->high.min * us, st->high.mean * us, (double)st->high.max * us,
+      (double)st->low.min * us, st->low.mean * us, (double)st->low.max * us, (double)st->idle_max * us);
+  }
+}
+
+// labels come from the command line, so quotes and backslashes have to be escaped
+static void sigstats_put_string(FILE* fp, const char* str) {
+  putc('"', fp);
+  for(const char* c = str; *c; c++) {
+    if((*c == '"') || (*c == '\\')) {
+      fprintf(fp, "\\%c", *c);
+    } else if((unsigned char)*c < 0x20) {
+      fprintf(fp, "\\u%04x", (unsigned char)*c);
+    } else {
+      putc(*c, fp);
+    }
+  }
+  putc('"', fp);
+}
+
+static void sigstats_put_pulses(FILE* fp, const char* name, const struct sigstats_pulses_t* pulses, double samp_rate) {
+  fprintf(fp, "\"%s\": { \"count\": %lu, \"min\": %.9f, \"mean\": %.9f, \"max\": %.9f }", name, pulses->num,
+    (double)pulses->min / samp_rate, pulses->mean / samp_rate, (double)pulses->max / samp_rate);
+}
+
+int sigstats_write_json(const char* path, const struct capture_t* cap, const struct sigstats_t* stats) {
+  FILE* fp = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+  if(!fp) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return(EXIT_FAILURE);
+  }
+
+  // all times are in seconds
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"samples\": %lu,\n", cap->num_samples);
+  fprintf(fp, "  \"sample_rate\": %.3f,\n", cap->samp_rate);
+  fprintf(fp, "  \"channels\": [\n");
+  for(unsigned int ch = 0; ch < cap->num_pins; ch++) {
+    const struct sigstats_t* st = &stats[ch];
+    fprintf(fp, "    { \"pin\": %d, \"label\": ", cap->pins[ch]);
+    sigstats_put_string(fp, cap->labels[ch]);
+    fprintf(fp, ", \"edges\": %lu, \"freq\": %.6f, \"duty\": %.6f, ", st->edges, st->freq, st->duty);
+    sigstats_put_pulses(fp, "high", &st->high, cap->samp_rate);
+    fprintf(fp, ", ");
+    sigstats_put_pulses(fp, "low", &st->low, cap->samp_rate);
+    fprintf(fp, ", \"idle_max\": %.9f }%s\n", (double)st->idle_max / cap->samp_rate, (ch < cap->num_pins - 1) ? "," : "");
+  }
+  fprintf(fp, "  ]\n");
+  fprintf(fp, "}\n");
+
+  int ret = ferror(fp) ? EXIT_FAILURE : EXIT_SUCCESS;
+  if(fp != stdout) {
+    if(fclose(fp) != 0) {
+      ret = EXIT_FAILURE;
+    }
+  } else {
+    fflush(fp);
+  }
+  return(ret);
+}
@@ -0,0 +1,42 @@
+#ifndef SIGSTATS_H
+#define SIGSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+#include "edges.h"
+
+// pulse widths of one level, in samples, only pulses with both edges inside the capture count
+struct sigstats_pulses_t {
+  size_t num;
+  size_t min;
+  size_t max;
+  double mean;
+};
+
+// summary of a single channel
+struct sigstats_t {
+  size_t edges;
+  struct sigstats_pulses_t high;
+  struct sigstats_pulses_t low;
+
+  // frequency in Hz from the rising edges and duty cycle from the mean pulse widths, 0 if unknown
+  double freq;
+  double duty;
+
+  // longest time without any edge in samples, including the start and the end of the capture
+  size_t idle_max;
+};
+
+// compute the statistics of all channels of the capture from the edge index
+void sigstats_compute(const struct edges_t* edges, const struct capture_t* cap, struct sigstats_t* stats);
+
+// print the statistics as a table
+void sigstats_print(FILE* fp, const struct capture_t* cap, const struct sigstats_t* stats);
+
+// write the statistics as JSON, path "-" is stdout
+int sigstats_write_json(const char* path, const struct capture_t* cap, const struct sigstats_t* stats);
+
+#endif
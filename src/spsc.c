@@ -0,0 +1,43 @@
+#include "spsc.h"
+
+void spsc_init(struct spsc_t* q, void** slots, size_t num_slots) {
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  q->slots = slots;
+  q->mask = num_slots - 1;
+  q->occupancy_max = 0;
+}
+
+bool spsc_push(struct spsc_t* q, void* item) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  if((tail - head) > q->mask) {
+    return(false);
+  }
+
+  q->slots[tail & q->mask] = item;
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+  if((tail + 1 - head) > q->occupancy_max) {
+    q->occupancy_max = tail + 1 - head;
+  }
+  return(true);
+}
+
+bool spsc_pop(struct spsc_t* q, void** item) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  if(head == tail) {
+    return(false);
+  }
+
+  *item = q->slots[head & q->mask];
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);
+  return(true);
+}
+
+size_t spsc_occupancy(struct spsc_t* q) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  return(tail - head);
+}
@@ -0,0 +1,35 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// keep producer and consumer indices in separate cache lines
+#define SPSC_CACHE_LINE     64
+
+// lock-free single-producer, single-consumer queue of pointers
+// storage for the slots is provided by the caller, the number of slots must be a power of 2
+struct spsc_t {
+  _Alignas(SPSC_CACHE_LINE) atomic_size_t head;
+  _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;
+  _Alignas(SPSC_CACHE_LINE) void** slots;
+  size_t mask;
+
+  // highest number of items seen in the queue, updated by the producer
+  size_t occupancy_max;
+};
+
+void spsc_init(struct spsc_t* q, void** slots, size_t num_slots);
+
+// called only from the producer, returns false if the queue is full
+bool spsc_push(struct spsc_t* q, void* item);
+
+// called only from the consumer, returns false if the queue is empty
+bool spsc_pop(struct spsc_t* q, void** item);
+
+// current number of items in the queue
+size_t spsc_occupancy(struct spsc_t* q);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "summary.h"
+#include "convert.h"
+#include "arena.h"
+
+// bucket counts of all levels, returns the number of levels
+static unsigned int summary_levels(size_t num_samples, size_t* num_buckets) {
+  unsigned int num_levels = 0;
+  size_t num = (num_samples + SUMMARY_BASE - 1) / SUMMARY_BASE;
+  while((num > 0) && (num_levels < SUMMARY_LEVELS_MAX)) {
+    num_buckets[num_levels++] = num;
+    if(num == 1) {
+      break;
+    }
+    num = (num + SUMMARY_FACTOR - 1) / SUMMARY_FACTOR;
+  }
+  return(num_levels);
+}
+
+static size_t summary_out_len(size_t num_samples, unsigned int unitsize) {
+  size_t num_buckets[SUMMARY_LEVELS_MAX];
+  unsigned int num_levels = summary_levels(num_samples, num_buckets);
+  size_t len = SUMMARY_HEADER_LEN + num_levels*SUMMARY_LEVEL_LEN;
+  for(unsigned int i = 0; i < num_levels; i++) {
+    len += 2 * num_buckets[i] * unitsize;
+  }
+  return(len);
+}
+
+size_t summary_mem_size(const struct capture_t* cap) {
+  size_t num_buckets[SUMMARY_LEVELS_MAX];
+  unsigned int num_levels = summary_levels(cap->num_samples, num_buckets);
+  size_t size = summary_out_len(cap->num_samples, (cap->num_pins + 7) / 8) + ARENA_ALIGN_DEFAULT;
+  for(unsigned int i = 0; i < num_levels; i++) {
+    size += 2 * (num_buckets[i] * sizeof(uint32_t) + ARENA_ALIGN_DEFAULT);
+  }
+  return(size);
+}
+
+int summary_init(struct summary_t* sum, const struct capture_t* cap) {
+  sum->unitsize = (cap->num_pins + 7) / 8;
+  sum->num_samples = cap->num_samples;
+  sum->num_levels = summary_levels(cap->num_samples, sum->num_buckets);
+  for(unsigned int i = 0; i < sum->num_levels; i++) {
+    sum->min[i] = arena_alloc(sum->num_buckets[i] * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+    sum->max[i] = arena_alloc(sum->num_buckets[i] * sizeof(uint32_t), ARENA_ALIGN_DEFAULT);
+    if(!sum->min[i] || !sum->max[i]) {
+      fprintf(stderr, "Failed to allocate summary\n");
+      return(EXIT_FAILURE);
+    }
+  }
+
+  sum->out_len = summary_out_len(cap->num_samples, sum->unitsize);
+  sum->out = arena_alloc(sum->out_len, ARENA_ALIGN_DEFAULT);
+  if(!sum->out) {
+    fprintf(stderr, "Failed to allocate summary\n");
+    return(EXIT_FAILURE);
+  }
+  // segments do not have to start on bucket boundaries, so level 0 is accumulated into
+  if(sum->num_levels) {
+    memset(sum->min[0], 0xFF, sum->num_buckets[0] * sizeof(uint32_t));
+    memset(sum->max[0], 0x00, sum->num_buckets[0] * sizeof(uint32_t));
+  }
+  return(EXIT_SUCCESS);
+}
+
+void summary_update(struct summary_t* sum, const struct segment_t* seg) {
+  if(seg->offset + seg->len > sum->num_samples) {
+    return;
+  }
+
+  // one bucket at a time, the inner loop is a plain reduction the compiler can vectorize
+  size_t i = 0;
+  while(i < seg->len) {
+    size_t pos = seg->offset + i;
+    size_t bucket = pos / SUMMARY_BASE;
+    size_t len = SUMMARY_BASE - (pos % SUMMARY_BASE);
+    if(len > seg->len - i) { len = seg->len - i; }
+
+    const uint32_t* samples = &seg->samples[i];
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    for(size_t j = 0; j < len; j++) {
+      min &= samples[j];
+      max |= samples[j];
+    }
+    sum->min[0][bucket] &= min;
+    sum->max[0][bucket] |= max;
+    i += len;
+  }
+}
+
+static void summary_put_le(uint8_t* buff, uint64_t val, int len) {
+  for(int i = 0; i < len; i++) {
+    buff[i] = (val >> (8*i)) & 0xFF;
+  }
+}
+
+size_t summary_finish(struct summary_t* sum) {
+  for(unsigned int l = 1; l < sum->num_levels; l++) {
+    const uint32_t* prev_min = sum->min[l - 1];
+    const uint32_t* prev_max = sum->max[l - 1];
+    size_t prev_num = sum->num_buckets[l - 1];
+    for(size_t b = 0; b < sum->num_buckets[l]; b++) {
+      uint32_t min = UINT32_MAX;
+      uint32_t max = 0;
+      for(size_t j = b*SUMMARY_FACTOR; (j < (b + 1)*SUMMARY_FACTOR) && (j < prev_num); j++) {
+        min &= prev_min[j];
+        max |= prev_max[j];
+      }
+      sum->min[l][b] = min;
+      sum->max[l][b] = max;
+    }
+  }
+
+  uint8_t* out = sum->out;
+  memset(out, 0, SUMMARY_HEADER_LEN);
+  memcpy(out, SUMMARY_MAGIC, sizeof(SUMMARY_MAGIC));
+  summary_put_le(&out[8], sum->unitsize, 4);
+  summary_put_le(&out[12], SUMMARY_BASE, 4);
+  summary_put_le(&out[16], SUMMARY_FACTOR, 4);
+  summary_put_le(&out[20], sum->num_levels, 4);
+  summary_put_le(&out[24], sum->num_samples, 8);
+
+  size_t offset = SUMMARY_HEADER_LEN + sum->num_levels*SUMMARY_LEVEL_LEN;
+  for(unsigned int l = 0; l < sum->num_levels; l++) {
+    uint8_t* entry = &out[SUMMARY_HEADER_LEN + l*SUMMARY_LEVEL_LEN];
+    summary_put_le(&entry[0], offset, 8);
+    summary_put_le(&entry[8], sum->num_buckets[l], 8);
+
+    size_t len = sum->num_buckets[l] * sum->unitsize;
+    convert_pack(sum->min[l], &out[offset], sum->num_buckets[l], sum->unitsize);
+    convert_pack(sum->max[l], &out[offset + len], sum->num_buckets[l], sum->unitsize);
+    offset += 2*len;
+  }
+  return(offset);
+}
@@ -0,0 +1,68 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "capture.h"
+
+/*
+  Min/max summary pyramid, lets viewers draw any zoom level without reading all samples.
+
+  Every level splits the capture into buckets, level 0 buckets hold SUMMARY_BASE samples
+  and every next level merges SUMMARY_FACTOR buckets of the previous one, up to a single bucket.
+  For each bucket there is the minimum (AND) and the maximum (OR) of its samples, so for channel N:
+  bit N clear in max - channel was low for the whole bucket, bit N set in min - channel was high,
+  otherwise it toggled within the bucket.
+
+  Stored layout, all values are little-endian.
+
+  offset  size  field
+  0       8     magic "PNLZSUM\0"
+  8       4     unitsize in bytes
+  12      4     samples per level 0 bucket
+  16      4     buckets merged per level
+  20      4     number of levels
+  24      8     number of samples
+  32      16*n  level table, see below
+  ...           levels, for each one first the minimum of all buckets, then the maximum,
+                packed to unitsize bytes the same way as samples
+
+  level table entry:
+  0       8     offset of the level from the start of the summary
+  8       8     number of buckets
+*/
+
+#define SUMMARY_MAGIC               "PNLZSUM"
+#define SUMMARY_BASE                (64)
+#define SUMMARY_FACTOR              (8)
+#define SUMMARY_LEVELS_MAX          (24)
+#define SUMMARY_HEADER_LEN          (32)
+#define SUMMARY_LEVEL_LEN           (16)
+
+struct summary_t {
+  unsigned int unitsize;
+  size_t num_samples;
+  unsigned int num_levels;
+  size_t num_buckets[SUMMARY_LEVELS_MAX];
+  uint32_t* min[SUMMARY_LEVELS_MAX];
+  uint32_t* max[SUMMARY_LEVELS_MAX];
+
+  // stored form, filled by summary_finish
+  uint8_t* out;
+  size_t out_len;
+};
+
+// number of bytes summary_init will allocate from the arena
+size_t summary_mem_size(const struct capture_t* cap);
+
+// allocate the pyramid for the capture from the arena, returns EXIT_SUCCESS or EXIT_FAILURE
+int summary_init(struct summary_t* sum, const struct capture_t* cap);
+
+// add a segment of samples to level 0, segments may come in any order
+void summary_update(struct summary_t* sum, const struct segment_t* seg);
+
+// merge the upper levels and pack everything to the stored form, returns its length
+size_t summary_finish(struct summary_t* sum);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "timing.h"
+
+static const char* phase_names[TIMING_NUM_PHASES] = {
+  "dma_map",
+  "dma_alloc",
+  "dma_cbs",
+  "memory",
+  "open",
+  "trigger",
+  "capture",
+  "close",
+};
+
+static struct timing_t {
+  double start[TIMING_NUM_PHASES];
+  double duration[TIMING_NUM_PHASES];
+} timing = {
+  .start = { 0 },
+  .duration = { 0 },
+};
+
+double timing_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((double)ts.tv_sec + (double)ts.tv_nsec/1.0e9);
+}
+
+void timing_begin(enum timing_phase_e phase) {
+  timing.start[phase] = timing_now();
+}
+
+void timing_end(enum timing_phase_e phase) {
+  timing.duration[phase] = timing_now() - timing.start[phase];
+}
+
+void timing_set(enum timing_phase_e phase, double seconds) {
+  timing.duration[phase] = seconds;
+}
+
+double timing_get(enum timing_phase_e phase) {
+  return(timing.duration[phase]);
+}
+
+static double timespec_diff(const struct timespec* start, const struct timespec* end) {
+  return((double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec)/1.0e9);
+}
+
+int timing_write_json(const char* path, const struct timing_report_t* report) {
+  FILE* fp = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+  if(!fp) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return(EXIT_FAILURE);
+  }
+
+  const struct capture_t* cap = report->cap;
+  double total = 0;
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"result\": \"%s\",\n", (report->result == EXIT_SUCCESS) ? "ok" : "error");
+  fprintf(fp, "  \"format\": \"%s\",\n", report->format);
+  fprintf(fp, "  \"file\": \"%s\",\n", report->filename);
+  fprintf(fp, "  \"phases\": {\n");
+  for(int i = 0; i < TIMING_NUM_PHASES; i++) {
+    fprintf(fp, "    \"%s\": %.9f,\n", phase_names[i], timing.duration[i]);
+    total += timing.duration[i];
+  }
+  fprintf(fp, "    \"total\": %.9f\n", total);
+  fprintf(fp, "  },\n");
+
+  fprintf(fp, "  \"capture\": {\n");
+  fprintf(fp, "    \"channels\": %u,\n", cap->num_pins);
+  fprintf(fp, "    \"samples\": %lu,\n", cap->num_samples);
+  fprintf(fp, "    \"sample_rate\": %.3f,\n", cap->samp_rate);
+  fprintf(fp, "    \"duration\": %.9f\n", timespec_diff(&cap->start, &cap->end));
+  fprintf(fp, "  },\n");
+
+  double ratio = report->bytes_written ? (double)report->bytes_raw / (double)report->bytes_written : 0;
+  fprintf(fp, "  \"output\": {\n");
+  fprintf(fp, "    \"bytes_raw\": %lu,\n", report->bytes_raw);
+  fprintf(fp, "    \"bytes_written\": %lu,\n", report->bytes_written);
+  fprintf(fp, "    \"compression_ratio\": %.3f\n", ratio);
+  fprintf(fp, "  },\n");
+
+  fprintf(fp, "  \"pipeline\": [\n");
+  for(int i = 0; i < PIPELINE_NUM_STAGES; i++) {
+    const struct pipeline_stage_stats_t* st = &report->pipeline->stages[i];
+    fprintf(fp, "    { \"stage\": \"%s\", \"segments\": %lu, \"busy\": %.9f, \"stalls_in\": %lu, \"stalls_out\": %lu, \"occupancy_max\": %lu }%s\n",
+      st->name, st->segments, st->busy, st->stalls_in, st->stalls_out, st->occupancy_max, (i < PIPELINE_NUM_STAGES - 1) ? "," : "");
+  }
+  fprintf(fp, "  ]\n");
+  fprintf(fp, "}\n");
+
+  int ret = ferror(fp) ? EXIT_FAILURE : EXIT_SUCCESS;
+  if(fp != stdout) {
+    if(fclose(fp) != 0) {
+      ret = EXIT_FAILURE;
+    }
+  } else {
+    fflush(fp);
+  }
+  return(ret);
+}
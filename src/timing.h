@@ -0,0 +1,52 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+#include "capture.h"
+#include "pipeline.h"
+
+// phases of a single program run, in the order they happen
+enum timing_phase_e {
+  TIMING_PHASE_DMA_MAP = 0,   // backend init, peripheral mapping, clock and PWM setup
+  TIMING_PHASE_DMA_ALLOC,     // allocation of the DMA memory
+  TIMING_PHASE_DMA_CBS,       // control block chain setup
+  TIMING_PHASE_MEMORY,        // arena reservation
+  TIMING_PHASE_OPEN,          // creation of the output file
+  TIMING_PHASE_TRIGGER,       // waiting for the trigger
+  TIMING_PHASE_CAPTURE,       // from DMA start until the last segment is passed to the exporter
+  TIMING_PHASE_CLOSE,         // finalizing the output, for sigrok this includes deflate and zip_close
+  TIMING_NUM_PHASES,
+};
+
+// everything reported in addition to the phase durations
+struct timing_report_t {
+  const struct capture_t* cap;
+  const char* format;
+  const char* filename;
+  int result;
+
+  // size of the packed samples and of the output file, the ratio of the two is the compression ratio
+  uint64_t bytes_raw;
+  uint64_t bytes_written;
+
+  const struct pipeline_stats_t* pipeline;
+};
+
+// monotonic clock in seconds
+double timing_now();
+
+// mark start and end of a phase
+void timing_begin(enum timing_phase_e phase);
+void timing_end(enum timing_phase_e phase);
+
+// set the duration of a phase that was measured elsewhere
+void timing_set(enum timing_phase_e phase, double seconds);
+
+// duration of the phase in seconds, 0 if it did not run
+double timing_get(enum timing_phase_e phase);
+
+// write phase durations and the report as JSON, path "-" is stdout
+int timing_write_json(const char* path, const struct timing_report_t* report);
+
+#endif
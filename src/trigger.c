@@ -0,0 +1,34 @@
+#include "trigger.h"
+
+bool trigger_edge(enum trig_type_e type, int prev, int curr) {
+  switch(type) {
+    case TRIG_TYPE_ANY:
+      return(curr != prev);
+    case TRIG_TYPE_RISING:
+      return((prev == 0) && (curr == 1));
+    case TRIG_TYPE_FALLING:
+      return((prev == 1) && (curr == 0));
+    default:
+      return(true);
+  }
+}
+
+size_t trigger_scan(const uint32_t* samples, size_t num_samples, unsigned int ch, enum trig_type_e type) {
+  if((type == TRIG_TYPE_IMMEDIATE) || (num_samples == 0)) {
+    return(0);
+  }
+
+  // looking for the sample that differs from its predecessor in the trigger channel and has the right level
+  const uint32_t mask = (1UL << ch);
+  const uint32_t level = (type == TRIG_TYPE_RISING) ? mask : 0;
+  uint32_t prev = samples[0] & mask;
+  for(size_t i = 1; i < num_samples; i++) {
+    uint32_t curr = samples[i] & mask;
+    if((curr != prev) && ((type == TRIG_TYPE_ANY) || (curr == level))) {
+      return(i);
+    }
+    prev = curr;
+  }
+
+  return(num_samples);
+}
@@ -0,0 +1,22 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+enum trig_type_e {
+  TRIG_TYPE_RISING = 0,
+  TRIG_TYPE_FALLING,
+  TRIG_TYPE_ANY,
+  TRIG_TYPE_IMMEDIATE,
+};
+
+// check whether the transition from prev to curr level matches the trigger
+bool trigger_edge(enum trig_type_e type, int prev, int curr);
+
+// find the first sample at which channel ch matches the trigger
+// returns num_samples if there is no such sample
+size_t trigger_scan(const uint32_t* samples, size_t num_samples, unsigned int ch, enum trig_type_e type);
+
+#endif
@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <linux/io_uring.h>
+
+#include "uring.h"
+
+struct uring_t {
+  int ring_fd;
+  int fd;
+
+  // submission queue
+  void* sq_ptr;
+  size_t sq_len;
+  unsigned int* sq_head;
+  unsigned int* sq_tail;
+  unsigned int* sq_mask;
+  unsigned int* sq_array;
+  struct io_uring_sqe* sqes;
+  size_t sqes_len;
+
+  // completion queue, may share the mapping with submission queue
+  void* cq_ptr;
+  size_t cq_len;
+  unsigned int* cq_head;
+  unsigned int* cq_tail;
+  unsigned int* cq_mask;
+  struct io_uring_cqe* cqes;
+
+  // registered buffer pool
+  unsigned int depth;
+  size_t buff_size;
+  uint8_t* buffs;
+  unsigned int* free_list;
+  unsigned int num_free;
+  unsigned int in_flight;
+  size_t* lens;
+  size_t* done;
+  off_t* offsets;
+  int error;
+
+  // statistics
+  struct timespec start;
+  struct timespec last;
+  uint64_t bytes;
+  unsigned int depth_max;
+  uint64_t depth_sum;
+  uint64_t num_submits;
+};
+
+static int uring_setup(unsigned int entries, struct io_uring_params* p) {
+  return(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+  return(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+static int uring_register(int fd, unsigned int opcode, void* arg, unsigned int nr_args) {
+  return(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+static double uring_elapsed(const struct timespec* a, const struct timespec* b) {
+  return((double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec)/1.0e9);
+}
+
+static void uring_queue_write(struct uring_t* ring, unsigned int idx) {
+  unsigned int tail = *ring->sq_tail;
+  unsigned int pos = tail & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[pos];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITE_FIXED;
+  sqe->fd = ring->fd;
+  sqe->addr = (uint64_t)(uintptr_t)(ring->buffs + idx*ring->buff_size + ring->done[idx]);
+  sqe->len = ring->lens[idx] - ring->done[idx];
+  sqe->off = ring->offsets[idx] + ring->done[idx];
+  sqe->buf_index = idx;
+  sqe->user_data = idx;
+  ring->sq_array[pos] = pos;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// process all available completions, returns number of buffers returned to the pool
+static unsigned int uring_reap(struct uring_t* ring) {
+  unsigned int reaped = 0;
+  unsigned int resubmit = 0;
+  unsigned int head = *ring->cq_head;
+  while(head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+    unsigned int idx = cqe->user_data;
+    head++;
+
+    if(cqe->res < 0) {
+      fprintf(stderr, "io_uring write failed: %s\n", strerror(-cqe->res));
+      ring->error = 1;
+    } else {
+      ring->bytes += cqe->res;
+      ring->done[idx] += cqe->res;
+      if((cqe->res > 0) && (ring->done[idx] < ring->lens[idx])) {
+        // short write, queue the rest again
+        uring_queue_write(ring, idx);
+        resubmit++;
+        continue;
+      } else if(ring->done[idx] < ring->lens[idx]) {
+        fprintf(stderr, "io_uring write made no progress\n");
+        ring->error = 1;
+      }
+    }
+
+    ring->free_list[ring->num_free++] = idx;
+    ring->in_flight--;
+    reaped++;
+  }
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+  if(resubmit) {
+    uring_enter(ring->ring_fd, resubmit, 0, 0);
+  }
+
+  if(reaped) {
+    clock_gettime(CLOCK_MONOTONIC, &ring->last);
+  }
+  return(reaped);
+}
+
+static int uring_wait(struct uring_t* ring) {
+  while(uring_reap(ring) == 0) {
+    if((uring_enter(ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR)) {
+      perror("io_uring_enter failed");
+      return(-1);
+    }
+  }
+  return(0);
+}
+
+struct uring_t* uring_open(int fd, unsigned int depth, size_t buff_size, uint8_t* buffs) {
+  struct uring_t* ring = calloc(1, sizeof(struct uring_t));
+  if(!ring) {
+    return(NULL);
+  }
+  ring->fd = fd;
+  ring->depth = depth;
+  ring->buff_size = buff_size;
+  ring->buffs = buffs;
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  ring->ring_fd = uring_setup(depth, &p);
+  if(ring->ring_fd < 0) {
+    free(ring);
+    return(NULL);
+  }
+
+  // map the queues
+  ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    if(ring->cq_len > ring->sq_len) { ring->sq_len = ring->cq_len; }
+    ring->cq_len = ring->sq_len;
+  }
+
+  ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+  if(ring->sq_ptr == MAP_FAILED) {
+    goto fail;
+  }
+
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ptr = ring->sq_ptr;
+  } else {
+    ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+    if(ring->cq_ptr == MAP_FAILED) {
+      goto fail;
+    }
+  }
+
+  ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+  if(ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    goto fail;
+  }
+
+  ring->sq_head = (unsigned int*)((uint8_t*)ring->sq_ptr + p.sq_off.head);
+  ring->sq_tail = (unsigned int*)((uint8_t*)ring->sq_ptr + p.sq_off.tail);
+  ring->sq_mask = (unsigned int*)((uint8_t*)ring->sq_ptr + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned int*)((uint8_t*)ring->sq_ptr + p.sq_off.array);
+  ring->cq_head = (unsigned int*)((uint8_t*)ring->cq_ptr + p.cq_off.head);
+  ring->cq_tail = (unsigned int*)((uint8_t*)ring->cq_ptr + p.cq_off.tail);
+  ring->cq_mask = (unsigned int*)((uint8_t*)ring->cq_ptr + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)((uint8_t*)ring->cq_ptr + p.cq_off.cqes);
+
+  // register the buffers, so that the kernel does not have to map them for every write
+  ring->free_list = calloc(depth, sizeof(unsigned int));
+  ring->lens = calloc(depth, sizeof(size_t));
+  ring->done = calloc(depth, sizeof(size_t));
+  ring->offsets = calloc(depth, sizeof(off_t));
+  struct iovec* iov = calloc(depth, sizeof(struct iovec));
+  if(!ring->free_list || !ring->lens || !ring->done || !ring->offsets || !iov) {
+    free(iov);
+    goto fail;
+  }
+
+  for(unsigned int i = 0; i < depth; i++) {
+    iov[i].iov_base = ring->buffs + i*buff_size;
+    iov[i].iov_len = buff_size;
+    ring->free_list[i] = i;
+  }
+  ring->num_free = depth;
+
+  int ret = uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iov, depth);
+  free(iov);
+  if(ret < 0) {
+    goto fail;
+  }
+
+  return(ring);
+
+fail:
+  uring_close(ring);
+  return(NULL);
+}
+
+uint8_t* uring_get_buffer(struct uring_t* ring) {
+  uring_reap(ring);
+  while(!ring->num_free) {
+    if(uring_wait(ring) < 0) {
+      return(NULL);
+    }
+  }
+
+  if(ring->error) {
+    return(NULL);
+  }
+
+  unsigned int idx = ring->free_list[--ring->num_free];
+  return(ring->buffs + idx*ring->buff_size);
+}
+
+int uring_submit(struct uring_t* ring, uint8_t* buff, size_t len, off_t offset) {
+  // the output is opened long before the capture, throughput is measured from the first write
+  if(ring->num_submits == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &ring->start);
+    ring->last = ring->start;
+  }
+
+  unsigned int idx = (buff - ring->buffs) / ring->buff_size;
+  ring->lens[idx] = len;
+  ring->done[idx] = 0;
+  ring->offsets[idx] = offset;
+  uring_queue_write(ring, idx);
+
+  int ret;
+  do {
+    ret = uring_enter(ring->ring_fd, 1, 0, 0);
+  } while((ret < 0) && (errno == EINTR));
+  if(ret < 0) {
+    perror("io_uring_enter failed");
+    return(EXIT_FAILURE);
+  }
+
+  ring->in_flight++;
+  if(ring->in_flight > ring->depth_max) { ring->depth_max = ring->in_flight; }
+  ring->depth_sum += ring->in_flight;
+  ring->num_submits++;
+
+  return(ring->error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int uring_drain(struct uring_t* ring) {
+  while(ring->in_flight) {
+    if(uring_wait(ring) < 0) {
+      return(EXIT_FAILURE);
+    }
+  }
+  return(ring->error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void uring_get_stats(struct uring_t* ring, struct uring_stats_t* stats) {
+  stats->bytes = ring->bytes;
+  stats->seconds = uring_elapsed(&ring->start, &ring->last);
+  stats->depth_max = ring->depth_max;
+  stats->depth_avg = ring->num_submits ? (double)ring->depth_sum / ring->num_submits : 0;
+}
+
+int uring_close(struct uring_t* ring) {
+  int ret = uring_drain(ring);
+
+  if(ring->sqes) { munmap(ring->sqes, ring->sqes_len); }
+  if(ring->cq_ptr && (ring->cq_ptr != MAP_FAILED) && (ring->cq_ptr != ring->sq_ptr)) { munmap(ring->cq_ptr, ring->cq_len); }
+  if(ring->sq_ptr && (ring->sq_ptr != MAP_FAILED)) { munmap(ring->sq_ptr, ring->sq_len); }
+  close(ring->ring_fd);
+
+  free(ring->free_list);
+  free(ring->lens);
+  free(ring->done);
+  free(ring->offsets);
+  free(ring);
+  return(ret);
+}
@@ -0,0 +1,40 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// asynchronous file writer based on io_uring
+// writes are done from a fixed pool of registered buffers, several of them can be in flight at once
+struct uring_t;
+
+struct uring_stats_t {
+  uint64_t bytes;
+  double seconds;
+  unsigned int depth_max;
+  double depth_avg;
+};
+
+// set up the ring for file descriptor fd, with depth buffers of buff_size bytes each
+// buffer memory is provided by the caller and should be page-aligned to allow O_DIRECT
+// returns NULL if io_uring is not available
+struct uring_t* uring_open(int fd, unsigned int depth, size_t buff_size, uint8_t* buffs);
+
+// get a free buffer, blocks until some write completes if all buffers are in flight
+// returns NULL on write error
+uint8_t* uring_get_buffer(struct uring_t* ring);
+
+// queue write of len bytes from buffer previously obtained by uring_get_buffer
+int uring_submit(struct uring_t* ring, uint8_t* buff, size_t len, off_t offset);
+
+// wait for all writes in flight to complete
+int uring_drain(struct uring_t* ring);
+
+// get the throughput and queue depth statistics
+void uring_get_stats(struct uring_t* ring, struct uring_stats_t* stats);
+
+// wait for all writes and release the ring, does not close the file descriptor
+int uring_close(struct uring_t* ring);
+
+#endif